@@ -0,0 +1,170 @@
+#pragma once
+// Small harness for the benchmark suite: repeated trials after a warm-up,
+// median/p95 per metric, host description and JSON output.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "md5_batch.h"
+
+namespace Benchmarking
+{
+    // Stores value where the optimiser has to assume it is read, so the loop
+    // producing it cannot be dropped
+    template <typename T>
+    void keep(const T& value)
+    {
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+
+    // CPU and build the numbers were taken on
+    struct Host
+    {
+        std::string cpu;
+        std::string isa;
+        unsigned threads;
+        std::string compiler;
+
+        static Host detect()
+        {
+            Host host;
+            host.cpu = "unknown";
+            std::ifstream cpuinfo("/proc/cpuinfo");
+            std::string line;
+            while (std::getline(cpuinfo, line))
+            {
+                if (line.rfind("model name", 0) == 0)
+                {
+                    size_t colon = line.find(':');
+                    host.cpu = line.substr(line.find_first_not_of(' ', colon + 1));
+                    break;
+                }
+            }
+
+            host.isa = Hashing::Md5Batch::isaName(Hashing::Md5Batch::detectIsa());
+            host.threads = std::thread::hardware_concurrency();
+            host.compiler = __VERSION__;
+            return host;
+        }
+    };
+
+    // Trial times of one metric; work is the number of units (hashes, strings,
+    // claims, ...) each trial processes
+    struct Result
+    {
+        std::string name;
+        std::string unit;
+        double work;
+        std::vector<double> seconds;
+
+        // Nearest-rank percentile of the trial times
+        double percentile(double p) const
+        {
+            std::vector<double> sorted = seconds;
+            std::sort(sorted.begin(), sorted.end());
+            size_t rank = static_cast<size_t>(p / 100.0 * sorted.size() + 0.999999);
+            return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+        }
+
+        double median() const
+        {
+            return percentile(50);
+        }
+
+        // Units per second at the median trial time
+        double rate() const
+        {
+            return work / median();
+        }
+    };
+
+    class Suite
+    {
+    public:
+        Suite(int trials, std::string filter)
+            : trials_(std::max(trials, 1)), filter_(std::move(filter)), host_(Host::detect())
+        {
+        }
+
+        const Host& host() const
+        {
+            return host_;
+        }
+
+        // Runs body once to warm up, then trials times, timing each call. Metrics
+        // whose name does not contain the filter are skipped.
+        void run(const std::string& name, const std::string& unit, double work, const std::function<void()>& body)
+        {
+            if (!filter_.empty() && name.find(filter_) == std::string::npos)
+                return;
+
+            Result result{name, unit, work, {}};
+            body();
+            for (int trial = 0; trial < trials_; ++trial)
+            {
+                auto start_time = std::chrono::steady_clock::now();
+                body();
+                result.seconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count());
+            }
+
+            std::cout << std::left << std::setw(36) << name << std::right << std::fixed << std::setprecision(2)
+                      << std::setw(12) << scaled(result.rate(), unit) << " " << std::left << std::setw(8) << unit << std::right
+                      << "  median " << std::setw(9) << result.median() * 1e3 << " ms"
+                      << "  p95 " << std::setw(9) << result.percentile(95) * 1e3 << " ms" << std::endl;
+            results_.push_back(std::move(result));
+        }
+
+        void writeJson(std::ostream& out) const
+        {
+            out << "{\n  \"host\": {\"cpu\": " << quote(host_.cpu) << ", \"isa\": " << quote(host_.isa)
+                << ", \"threads\": " << host_.threads << ", \"compiler\": " << quote(host_.compiler) << "},\n"
+                << "  \"trials\": " << trials_ << ",\n  \"metrics\": [\n";
+            out << std::setprecision(9);
+            for (size_t i = 0; i < results_.size(); ++i)
+            {
+                const Result& result = results_[i];
+                out << "    {\"name\": " << quote(result.name) << ", \"unit\": " << quote(result.unit)
+                    << ", \"work\": " << result.work << ", \"rate\": " << result.rate()
+                    << ", \"median_s\": " << result.median() << ", \"p95_s\": " << result.percentile(95)
+                    << ", \"min_s\": " << result.percentile(0) << ", \"seconds\": [";
+                for (size_t t = 0; t < result.seconds.size(); ++t)
+                    out << (t == 0 ? "" : ", ") << result.seconds[t];
+                out << "]}" << (i + 1 < results_.size() ? "," : "") << "\n";
+            }
+            out << "  ]\n}\n";
+        }
+
+    private:
+        int trials_;
+        std::string filter_;
+        Host host_;
+        std::vector<Result> results_;
+
+        // Rates are printed in millions for the M-prefixed units
+        static double scaled(double rate, const std::string& unit)
+        {
+            return unit.front() == 'M' ? rate / 1e6 : rate;
+        }
+
+        static std::string quote(const std::string& text)
+        {
+            std::string result = "\"";
+            for (char c : text)
+            {
+                if (c == '"' || c == '\\')
+                    result += '\\';
+                if (static_cast<unsigned char>(c) >= 0x20)
+                    result += c;
+            }
+            return result + "\"";
+        }
+    };
+}
@@ -0,0 +1,190 @@
+// Known-answer checks of MD5 (scalar, batch and incremental) and of the batch
+// hashers (SHA-1, SHA-256, NTLM) on every instruction set the CPU supports, and
+// the throughput of the latter. Exits non-zero if any digest is wrong, so
+// `make bench` doubles as their self-test.
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <string_view>
+
+#include "md5_batch.h"
+#include "md5_incremental.h"
+#include "sha1.h"
+#include "sha256.h"
+#include "ntlm.h"
+#include "generator.h"
+
+namespace
+{
+    struct KnownAnswer
+    {
+        std::string message;
+        std::string hex;
+    };
+
+    const std::string Long = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+
+    // Checks the scalar digest and every lane of every supported kernel against
+    // the known answers; returns the number of failures
+    template <typename Hasher>
+    int check(const std::vector<KnownAnswer>& answers)
+    {
+        int failures = 0;
+        for (const KnownAnswer& answer : answers)
+        {
+            std::string scalar = Hasher::toHex(Hasher::digest(answer.message));
+            if (scalar != answer.hex || Hasher::fromHex(answer.hex) != Hasher::digest(answer.message))
+            {
+                std::cout << Hasher::Name << " scalar \"" << answer.message << "\": got " << scalar << ", expected " << answer.hex << std::endl;
+                ++failures;
+            }
+
+            for (Hashing::Isa isa : {Hashing::Isa::Scalar, Hashing::Isa::Sse2, Hashing::Isa::Avx2, Hashing::Isa::Avx512})
+            {
+                if (!Hashing::Md5Batch::isSupported(isa))
+                    continue;
+
+                Hasher hasher(isa);
+                std::vector<std::string_view> views(Hasher::MaxLanes + 1, answer.message);
+                std::vector<typename Hasher::Digest> digests(views.size());
+                hasher.hashBatch(views.data(), views.size(), digests.data());
+                for (size_t lane = 0; lane < digests.size(); ++lane)
+                {
+                    if (Hasher::toHex(digests[lane]) != answer.hex)
+                    {
+                        std::cout << Hasher::Name << " " << Hashing::Md5Batch::isaName(isa) << " lane " << lane << " \""
+                                  << answer.message << "\": got " << Hasher::toHex(digests[lane]) << std::endl;
+                        ++failures;
+                        break;
+                    }
+                }
+            }
+        }
+
+        std::cout << std::left << std::setw(10) << Hasher::Name << (failures == 0 ? "known answers ok" : "known answers FAILED") << std::endl;
+        return failures;
+    }
+
+    // Md5Incremental on every lane of every supported kernel, with one and two
+    // varying words, hashing and reversed matching, for the answers whose length
+    // it supports
+    int checkIncremental(const std::vector<KnownAnswer>& answers)
+    {
+        int failures = 0;
+        for (const KnownAnswer& answer : answers)
+        {
+            size_t length = answer.message.size();
+            if (length == 0 || length > Hashing::Md5::MaxSingleBlockSize)
+                continue;
+
+            for (Hashing::Isa isa : {Hashing::Isa::Scalar, Hashing::Isa::Sse2, Hashing::Isa::Avx2, Hashing::Isa::Avx512})
+            {
+                if (!Hashing::Md5Batch::isSupported(isa))
+                    continue;
+
+                for (size_t varying = 1; varying <= (length > 4 ? 2 : 1); ++varying)
+                {
+                    Hashing::Md5Incremental engine(length, isa, varying);
+                    uint32_t leading[Hashing::Md5Batch::MaxLanes];
+                    uint32_t words[Hashing::Md5Batch::MaxLanes];
+                    Hashing::Md5Digest digests[Hashing::Md5Batch::MaxLanes];
+                    engine.setPrefix(answer.message.data());
+                    for (size_t lane = 0; lane < engine.lanes(); ++lane)
+                    {
+                        leading[lane] = engine.leadingWordOf(answer.message.data());
+                        words[lane] = engine.varyingWordOf(answer.message.data());
+                    }
+                    engine.hashWords(leading, words, digests);
+
+                    bool ok = true;
+                    for (size_t lane = 0; lane < engine.lanes(); ++lane)
+                        ok = ok && Hashing::Md5::toHex(digests[lane]) == answer.hex;
+
+                    uint32_t all = (1u << engine.lanes()) - 1;
+                    engine.setTargets({Hashing::Md5::fromHex(answer.hex)});
+                    engine.setPrefix(answer.message.data());
+                    ok = ok && engine.matchWords(leading, words) == all;
+
+                    if (!ok)
+                    {
+                        std::cout << "MD5 incremental " << Hashing::Md5Batch::isaName(isa) << " (" << varying << " words) \""
+                                  << answer.message << "\": got " << Hashing::Md5::toHex(digests[0]) << std::endl;
+                        ++failures;
+                    }
+                }
+            }
+        }
+
+        std::cout << std::left << std::setw(10) << "MD5 incr." << (failures == 0 ? "known answers ok" : "known answers FAILED") << std::endl;
+        return failures;
+    }
+
+    template <typename Hasher>
+    void measure(const std::vector<std::string_view>& candidates)
+    {
+        for (Hashing::Isa isa : {Hashing::Isa::Scalar, Hashing::Isa::Sse2, Hashing::Isa::Avx2, Hashing::Isa::Avx512})
+        {
+            if (!Hashing::Md5Batch::isSupported(isa))
+                continue;
+
+            Hasher hasher(isa);
+            std::vector<typename Hasher::Digest> digests(candidates.size());
+
+            auto start_time = std::chrono::steady_clock::now();
+            hasher.hashBatch(candidates.data(), candidates.size(), digests.data());
+            std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start_time;
+
+            std::cout << std::left << std::setw(28) << (std::string(Hasher::Name) + " " + Hashing::Md5Batch::isaName(isa))
+                      << std::right << std::setw(12) << std::fixed << std::setprecision(2)
+                      << candidates.size() / duration.count() / 1e6 << " MH/s"
+                      << "  (checksum " << std::hex << digests.back()[0] << std::dec << ")" << std::endl;
+        }
+    }
+}
+
+int main()
+{
+    // RFC 1321 test suite, plus prefixes of its last message on either side of
+    // the padding boundaries: 55 bytes still fit one block, 56 and 64 need two
+    const std::string Digits = "12345678901234567890123456789012345678901234567890123456789012345678901234567890";
+    const std::vector<KnownAnswer> md5 = {{"", "d41d8cd98f00b204e9800998ecf8427e"},
+                                          {"a", "0cc175b9c0f1b6a831c399e269772661"},
+                                          {"abc", "900150983cd24fb0d6963f7d28e17f72"},
+                                          {"message digest", "f96b697d7cb7938d525a2f31aaf161d0"},
+                                          {"abcdefghijklmnopqrstuvwxyz", "c3fcd3d76192e4007dfb496cca67e13b"},
+                                          {"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789", "d174ab98d277d9f5a5611c2c9f419d9f"},
+                                          {Digits, "57edf4a22be3c955ac49da2e2107b67a"},
+                                          {Digits.substr(0, 55), "c9ccf168914a1bcfc3229f1948e67da0"},
+                                          {Digits.substr(0, 56), "49f193adce178490e34d1b3a4ec0064c"},
+                                          {Digits.substr(0, 64), "eb6c4179c0a7c82cc2828c1e6338e165"}};
+
+    int failures = 0;
+    failures += check<Hashing::Md5Batch>(md5);
+    failures += checkIncremental(md5);
+    failures += check<Hashing::Sha1>({{"", "da39a3ee5e6b4b0d3255bfef95601890afd80709"},
+                                      {"abc", "a9993e364706816aba3e25717850c26c9cd0d89d"},
+                                      {Long, "84983e441c3bd26ebaae4aa1f95129e5e54670f1"}});
+    failures += check<Hashing::Sha256>({{"", "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"},
+                                        {"abc", "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"},
+                                        {Long, "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"}});
+    failures += check<Hashing::Ntlm>({{"", "31d6cfe0d16ae931b73c59d7e0c089c0"},
+                                      {"password", "8846f7eaee8fb117ad06bdd830b7586c"}});
+    if (failures != 0)
+        return 1;
+
+    size_t count = 2'000'000;
+    std::vector<std::string> keys;
+    keys.reserve(count);
+    Generators::StringGenerator generator(6, "abcdefghijklmnopqrstuvwxyz");
+    while (generator.hasNext() && keys.size() < count)
+        keys.push_back(generator.next());
+    std::vector<std::string_view> candidates(keys.begin(), keys.end());
+
+    std::cout << "### Batch hasher throughput over " << candidates.size() << " candidates of length 6" << std::endl;
+    measure<Hashing::Sha1>(candidates);
+    measure<Hashing::Sha256>(candidates);
+    measure<Hashing::Ntlm>(candidates);
+    return 0;
+}
@@ -0,0 +1,195 @@
+// Microbenchmark for the MD5 entry points: the string API, the allocation-free
+// raw digest and the multi-buffer batch engine. Build and run with `make bench`.
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <cstring>
+
+#include "hasher.h"
+#include "md5_batch.h"
+#include "md5_incremental.h"
+#include "generator.h"
+
+namespace
+{
+    // Reproduces the allocation pattern of the original Md5::hash (padded copy of
+    // the message built with +=, digest formatted through an ostringstream) so the
+    // numbers below can be compared against the old implementation.
+    std::string legacyHash(const std::string& msg)
+    {
+        std::string processed = msg;
+        processed += static_cast<char>(0x80);
+        while ((processed.size() * 8) % 512 != 448)
+            processed += static_cast<char>(0x00);
+
+        uint64_t original_length_bits = static_cast<uint64_t>(msg.size()) * 8;
+        for (int i = 0; i < 8; ++i)
+            processed += static_cast<char>((original_length_bits >> (i * 8)) & 0xFF);
+
+        Hashing::Md5Digest state = Hashing::Md5::IV;
+        for (size_t chunk = 0; chunk < processed.size(); chunk += 64)
+        {
+            uint32_t M[16];
+            std::memcpy(M, processed.data() + chunk, 64);
+            Hashing::Md5::compress(state.data(), M);
+        }
+
+        std::ostringstream oss;
+        oss << std::hex << std::setfill('0');
+        for (uint32_t word : state)
+        {
+            for (int i = 0; i < 4; ++i)
+                oss << std::setw(2) << ((word >> (i * 8)) & 0xFF);
+        }
+        return oss.str();
+    }
+
+    template <typename Body>
+    void measure(const std::string& name, const std::vector<std::string>& candidates, Body body)
+    {
+        // Warm-up pass so caches and the branch predictor are primed
+        uint32_t sink = 0;
+        for (const std::string& candidate : candidates)
+            sink += body(candidate);
+
+        auto start_time = std::chrono::steady_clock::now();
+        for (const std::string& candidate : candidates)
+            sink += body(candidate);
+        auto end_time = std::chrono::steady_clock::now();
+
+        std::chrono::duration<double> duration = end_time - start_time;
+        std::cout << std::left << std::setw(28) << name
+                  << std::right << std::setw(12) << std::fixed << std::setprecision(2)
+                  << candidates.size() / duration.count() / 1e6 << " MH/s"
+                  << "  (checksum " << std::hex << sink << std::dec << ")" << std::endl;
+    }
+}
+
+int main()
+{
+    size_t size = 5;
+    std::string charset = "abcdefghijklmnopqrstuvwxyz";
+    size_t count = 2'000'000;
+
+    std::vector<std::string> candidates;
+    candidates.reserve(count);
+    Generators::StringGenerator generator(size, charset);
+    while (generator.hasNext() && candidates.size() < count)
+        candidates.push_back(generator.next());
+
+    std::cout << "### MD5 throughput over " << candidates.size() << " candidates of length " << size << std::endl;
+
+    measure("legacy hash (string)", candidates, [](const std::string& s)
+            { return static_cast<uint32_t>(legacyHash(s)[0]); });
+
+    Hashing::Md5 md5{};
+    measure("Md5::hash (string)", candidates, [&md5](const std::string& s)
+            { return static_cast<uint32_t>(md5.hash(s)[0]); });
+
+    measure("Md5::digest (raw)", candidates, [](const std::string& s)
+            { return Hashing::Md5::digest(s)[0]; });
+
+    measure("Md5::digest + toHex(char*)", candidates, [](const std::string& s)
+            {
+                char hex[32];
+                Hashing::Md5::toHex(Hashing::Md5::digest(s), hex);
+                return static_cast<uint32_t>(hex[0]); });
+
+    for (Hashing::Isa isa : {Hashing::Isa::Scalar, Hashing::Isa::Sse2, Hashing::Isa::Avx2, Hashing::Isa::Avx512})
+    {
+        if (!Hashing::Md5Batch::isSupported(isa))
+            continue;
+
+        Hashing::Md5Batch batch(isa);
+        std::vector<std::string_view> views(candidates.begin(), candidates.end());
+        std::vector<Hashing::Md5Digest> digests(views.size());
+
+        auto start_time = std::chrono::steady_clock::now();
+        batch.hashBatch(views.data(), views.size(), digests.data());
+        auto end_time = std::chrono::steady_clock::now();
+
+        std::chrono::duration<double> duration = end_time - start_time;
+        std::cout << std::left << std::setw(28) << (std::string("Md5Batch::hashBatch ") + Hashing::Md5Batch::isaName(isa))
+                  << std::right << std::setw(12) << std::fixed << std::setprecision(2)
+                  << views.size() / duration.count() / 1e6 << " MH/s"
+                  << "  (checksum " << std::hex << digests.back()[0] << std::dec << ")" << std::endl;
+    }
+
+    // Kernel-only comparison on the sweep lengths we run: every engine hashes the
+    // same consecutive candidates, the incremental one re-prefixing as it goes
+    for (size_t length : {5, 6, 7})
+    {
+        std::cout << "### Kernel throughput, length " << length << std::endl;
+
+        Generators::StringGenerator sweep(length, charset);
+        std::vector<std::string> keys;
+        keys.reserve(count);
+        while (sweep.hasNext() && keys.size() < count)
+            keys.push_back(sweep.next());
+
+        Hashing::Md5Batch batch;
+        Hashing::Md5Incremental incremental(length);
+        Hashing::Md5Incremental reversed(length);
+        reversed.setTargets({Hashing::Md5::digest(std::string(length, '~'))});
+
+        size_t lanes = batch.lanes();
+        alignas(64) uint32_t words[16 * Hashing::Md5Batch::MaxLanes];
+        Hashing::Md5Digest digests[Hashing::Md5Batch::MaxLanes];
+        uint32_t sink = 0;
+
+        auto start_time = std::chrono::steady_clock::now();
+        for (size_t i = 0; i + lanes <= keys.size(); i += lanes)
+        {
+            std::memset(words, 0, sizeof(words));
+            for (size_t lane = 0; lane < lanes; ++lane)
+                Hashing::Md5Batch::packMessage(keys[i + lane], words, Hashing::Md5Batch::MaxLanes, lane);
+            batch.hashBlock(words, Hashing::Md5Batch::MaxLanes, digests);
+            sink += digests[0][0];
+        }
+        std::chrono::duration<double> batch_time = std::chrono::steady_clock::now() - start_time;
+
+        auto runIncremental = [&](Hashing::Md5Incremental& engine)
+        {
+            auto begin = std::chrono::steady_clock::now();
+            std::string prefix;
+            for (size_t i = 0; i + lanes <= keys.size(); i += lanes)
+            {
+                for (size_t lane = 0; lane < lanes; ++lane)
+                {
+                    const std::string& key = keys[i + lane];
+                    if (key.compare(0, engine.prefixSize(), prefix) != 0)
+                    {
+                        prefix = key.substr(0, engine.prefixSize());
+                        engine.setPrefix(key.data());
+                    }
+                    words[lane] = engine.varyingWordOf(key.data());
+                }
+                if (engine.reversing())
+                {
+                    sink += engine.matchWords(words);
+                }
+                else
+                {
+                    engine.hashWords(words, digests);
+                    sink += digests[0][0];
+                }
+            }
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin);
+        };
+
+        std::chrono::duration<double> incremental_time = runIncremental(incremental);
+        std::chrono::duration<double> reversed_time = runIncremental(reversed);
+
+        std::cout << std::left << std::setw(28) << "Md5Batch::hashBlock" << std::right << std::setw(12)
+                  << keys.size() / batch_time.count() / 1e6 << " MH/s" << std::endl;
+        std::cout << std::left << std::setw(28) << "Md5Incremental::hashWords" << std::right << std::setw(12)
+                  << keys.size() / incremental_time.count() / 1e6 << " MH/s" << std::endl;
+        std::cout << std::left << std::setw(28) << "Md5Incremental::matchWords" << std::right << std::setw(12)
+                  << keys.size() / reversed_time.count() / 1e6 << " MH/s  (checksum " << std::hex << sink << std::dec << ")" << std::endl;
+    }
+
+    return 0;
+}
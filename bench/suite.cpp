@@ -0,0 +1,265 @@
+// Benchmark suite: hash kernels, generator, scheduling and end-to-end sweeps as
+// separate metrics, each over repeated trials after a warm-up. Prints a table
+// and, with --json FILE, a machine-readable report to compare builds against.
+// A few end-to-end checks run first; the suite exits non-zero if one fails.
+//
+//   bin/suite [--trials N] [--json FILE] [--filter TEXT]
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <filesystem>
+#include <optional>
+#include <set>
+#include <unistd.h>
+
+#include "harness.h"
+#include "md5_batch.h"
+#include "md5_incremental.h"
+#include "sha1.h"
+#include "sha256.h"
+#include "ntlm.h"
+#include "generator.h"
+#include "scheduler.h"
+#include "worker_pool.h"
+#include "cracker.h"
+#include "options.h"
+
+namespace
+{
+    const std::string Charset = "abcdefghijklmnopqrstuvwxyz";
+    constexpr size_t Blocks = 1 << 16;
+
+    std::vector<Hashing::Isa> supportedIsas()
+    {
+        std::vector<Hashing::Isa> isas;
+        for (Hashing::Isa isa : {Hashing::Isa::Scalar, Hashing::Isa::Sse2, Hashing::Isa::Avx2, Hashing::Isa::Avx512})
+        {
+            if (Hashing::Md5Batch::isSupported(isa))
+                isas.push_back(isa);
+        }
+        return isas;
+    }
+
+    // Hash kernels over pre-packed blocks, so only the compression is timed
+    void kernels(Benchmarking::Suite& suite)
+    {
+        alignas(64) uint32_t words[16 * Hashing::Md5Batch::MaxLanes] = {};
+        for (size_t lane = 0; lane < Hashing::Md5Batch::MaxLanes; ++lane)
+            Hashing::Md5Batch::packMessage("abcdefg", words, Hashing::Md5Batch::MaxLanes, lane);
+
+        uint32_t sink = 0;
+        for (Hashing::Isa isa : supportedIsas())
+        {
+            Hashing::Md5Batch md5(isa);
+            Hashing::Md5Digest digests[Hashing::Md5Batch::MaxLanes];
+            suite.run(std::string("kernel.md5.") + Hashing::Md5Batch::isaName(isa), "MH/s", double(Blocks) * md5.lanes(), [&]()
+                      {
+                for (size_t i = 0; i < Blocks; ++i)
+                {
+                    words[0] = static_cast<uint32_t>(i);
+                    md5.hashBlock(words, Hashing::Md5Batch::MaxLanes, digests);
+                    sink += digests[0][0];
+                } });
+        }
+
+        Hashing::Md5Incremental incremental(7);
+        incremental.setPrefix("abcdefg");
+        uint32_t varying[Hashing::Md5Batch::MaxLanes] = {};
+        Hashing::Md5Digest digests[Hashing::Md5Batch::MaxLanes];
+        suite.run("kernel.md5_incremental", "MH/s", double(Blocks) * incremental.lanes(), [&]()
+                  {
+            for (size_t i = 0; i < Blocks; ++i)
+            {
+                varying[0] = static_cast<uint32_t>(i);
+                incremental.hashWords(varying, digests);
+                sink += digests[0][0];
+            } });
+
+        auto other = [&](auto hasher, const char* name)
+        {
+            using Hasher = decltype(hasher);
+            alignas(64) uint32_t packed[16 * Hasher::MaxLanes] = {};
+            for (size_t lane = 0; lane < Hasher::MaxLanes; ++lane)
+                Hasher::packMessage("abcdefg", packed, Hasher::MaxLanes, lane);
+
+            typename Hasher::Digest out[Hasher::MaxLanes];
+            suite.run(std::string("kernel.") + name + "." + Hashing::Md5Batch::isaName(hasher.isa()), "MH/s", double(Blocks) * hasher.lanes(), [&]()
+                      {
+                for (size_t i = 0; i < Blocks; ++i)
+                {
+                    packed[0] = static_cast<uint32_t>(i);
+                    hasher.hashBlock(packed, Hasher::MaxLanes, out);
+                    sink += out[0][0];
+                } });
+        };
+        other(Hashing::Sha1(), "sha1");
+        other(Hashing::Sha256(), "sha256");
+        other(Hashing::Ntlm(), "ntlm");
+
+        Benchmarking::keep(sink);
+    }
+
+    // Candidate production alone, both the string and the block interface
+    void generator(Benchmarking::Suite& suite)
+    {
+        constexpr size_t Count = 1 << 22;
+        uint64_t sink = 0;
+
+        suite.run("generator.next", "Mstr/s", Count, [&]()
+                  {
+            Generators::StringGenerator generator(7, Charset, 0, Count);
+            char candidate[7];
+            while (generator.next(candidate))
+                sink += static_cast<uint8_t>(candidate[6]); });
+
+        suite.run("generator.next_batch", "Mstr/s", Count, [&]()
+                  {
+            Generators::StringGenerator generator(7, Charset, 0, Count);
+            Generators::CandidateBlock<7> block;
+            while (generator.nextBatch(block) != 0)
+                sink += block.words[0][0]; });
+
+        suite.run("generator.mask", "Mstr/s", Count, [&]()
+                  {
+            Generators::StringGenerator generator(Generators::Mask::parse("?u?l?l?l?d?d?d"), 0, Count);
+            char candidate[7];
+            while (generator.next(candidate))
+                sink += static_cast<uint8_t>(candidate[6]); });
+
+        Benchmarking::keep(sink);
+    }
+
+    // Cost of handing out work: single-threaded claims and a pool round trip
+    void scheduling(Benchmarking::Suite& suite)
+    {
+        constexpr size_t Claims = 1 << 16;
+        suite.run("scheduler.claim", "Mclaims/s", Claims, [&]()
+                  {
+            LoadBalancing::DynamicScheduler scheduler({{0, Generators::Index{Claims} << 12}}, 1, 1 << 12, 1 << 12);
+            LoadBalancing::Range chunk;
+            while (scheduler.claim(0, chunk))
+            {
+            } });
+
+        LoadBalancing::WorkerPool<int> pool(2, [](int, const int&, LoadBalancing::Range) {});
+        constexpr size_t Runs = 64;
+        suite.run("pool.dispatch", "runs/s", Runs, [&]()
+                  {
+            for (size_t i = 0; i < Runs; ++i)
+                pool.run(0, 1); });
+    }
+
+    // Wordlists and rules repeat candidates; every target must still be reported
+    // exactly once and the job must not stop before the last one is found.
+    // Returns the number of failures.
+    int duplicates()
+    {
+        std::filesystem::path dir = std::filesystem::temp_directory_path();
+        std::string wordlist = (dir / ("suite-words-" + std::to_string(getpid()))).string();
+        std::string rules = (dir / ("suite-rules-" + std::to_string(getpid()))).string();
+
+        struct Case
+        {
+            const char* name;
+            const char* words;
+            const char* rules;
+        };
+
+        int failures = 0;
+        for (const Case& test : {Case{"repeated words", "abc\nabc\nzzzz\n", ""}, Case{"rules : and l", "abc\nzzzz\n", ":\nl\n"}})
+        {
+            std::ofstream(wordlist) << test.words;
+            std::ofstream(rules) << test.rules;
+
+            Cracking::CrackConfig config;
+            config.wordlist = wordlist;
+            config.rules_file = *test.rules != '\0' ? rules : "";
+            config.num_forks = 2;
+            config.targets = {Hashing::Md5::digest("abc"), Hashing::Md5::digest("zzzz")};
+            Cracking::CrackResult result = Cracking::Cracker(config).run();
+
+            std::set<Hashing::Md5Digest> found;
+            for (const Cracking::Match& match : result.matches)
+                found.insert(match.digest);
+            if (result.matches.size() != config.targets.size() || found.size() != config.targets.size())
+            {
+                std::cout << "check " << test.name << ": " << result.matches.size() << " matches for "
+                          << found.size() << " of " << config.targets.size() << " targets" << std::endl;
+                ++failures;
+            }
+        }
+
+        std::filesystem::remove(wordlist);
+        std::filesystem::remove(rules);
+        std::cout << (failures == 0 ? "duplicate candidates ok" : "duplicate candidates FAILED") << std::endl;
+        return failures;
+    }
+
+    // Whole crack jobs over a keyspace without a match, spawn included
+    void sweeps(Benchmarking::Suite& suite)
+    {
+        size_t size = 5;
+        double total = static_cast<double>(Generators::StringGenerator::totalCombinations(size, Charset));
+        unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+
+        auto sweep = [&](const std::string& name, int forks, Cracking::Engine engine, Hashing::Algorithm algorithm)
+        {
+            Cracking::CrackConfig config;
+            config.size = size;
+            config.num_forks = forks;
+            config.engine = engine;
+            config.algorithm = algorithm;
+            config.targets = {Hashing::Md5Digest{1, 2, 3, 4}};
+            Cracking::Cracker cracker(config);
+            suite.run(name, "MH/s", total, [&]() { cracker.run(); });
+        };
+
+        sweep("sweep.md5.batch.1", 1, Cracking::Engine::Batch, Hashing::Algorithm::Md5);
+        sweep("sweep.md5.incremental.1", 1, Cracking::Engine::Incremental, Hashing::Algorithm::Md5);
+        if (threads > 1)
+            sweep("sweep.md5.batch." + std::to_string(threads), static_cast<int>(threads), Cracking::Engine::Batch, Hashing::Algorithm::Md5);
+        sweep("sweep.sha1.batch." + std::to_string(threads), static_cast<int>(threads), Cracking::Engine::Batch, Hashing::Algorithm::Sha1);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::optional<Cli::Options> options;
+    int trials;
+    try
+    {
+        options.emplace(argc - 1, argv + 1, std::set<std::string>{}, std::set<std::string>{"trials", "filter", "json"});
+        trials = options->getInt("trials", 7);
+    }
+    catch (const std::invalid_argument& ex)
+    {
+        std::cerr << "Error: " << ex.what() << std::endl;
+        return 2;
+    }
+    Benchmarking::Suite suite(trials, options->get("filter"));
+
+    const Benchmarking::Host& host = suite.host();
+    std::cout << "### " << host.cpu << ", " << host.threads << " threads, " << host.isa << ", " << host.compiler << std::endl;
+
+    if (duplicates() != 0)
+        return 1;
+
+    kernels(suite);
+    generator(suite);
+    scheduling(suite);
+    sweeps(suite);
+
+    if (options->has("json"))
+    {
+        std::ofstream file(options->get("json"));
+        if (!file.is_open())
+        {
+            std::cerr << "Unable to open file '" << options->get("json") << "'" << std::endl;
+            return 1;
+        }
+        suite.writeJson(file);
+    }
+    return 0;
+}
@@ -0,0 +1,97 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <stdexcept>
+
+#include "hasher.h"
+#include "md5_batch.h"
+#include "sha1.h"
+#include "sha256.h"
+#include "ntlm.h"
+
+namespace Hashing
+{
+    // Hash functions the sweeps can target
+    enum class Algorithm
+    {
+        Md5,
+        Sha1,
+        Sha256,
+        Ntlm
+    };
+
+    inline Algorithm parseAlgorithm(const std::string& name)
+    {
+        if (name == "md5")
+            return Algorithm::Md5;
+        if (name == "sha1")
+            return Algorithm::Sha1;
+        if (name == "sha256")
+            return Algorithm::Sha256;
+        if (name == "ntlm")
+            return Algorithm::Ntlm;
+        throw std::invalid_argument("Unknown hash '" + name + "', expected 'md5', 'sha1', 'sha256' or 'ntlm'.");
+    }
+
+    inline const char* algorithmName(Algorithm algorithm)
+    {
+        switch (algorithm)
+        {
+        case Algorithm::Sha1:
+            return "sha1";
+        case Algorithm::Sha256:
+            return "sha256";
+        case Algorithm::Ntlm:
+            return "ntlm";
+        default:
+            return "md5";
+        }
+    }
+
+    // Calls f(std::type_identity<Hasher>{}) with the batch hasher of algorithm, so
+    // the caller is instantiated once per algorithm instead of dispatching per candidate
+    template <typename F>
+    decltype(auto) withAlgorithm(Algorithm algorithm, F&& f)
+    {
+        switch (algorithm)
+        {
+        case Algorithm::Sha1:
+            return f(std::type_identity<Sha1>{});
+        case Algorithm::Sha256:
+            return f(std::type_identity<Sha256>{});
+        case Algorithm::Ntlm:
+            return f(std::type_identity<Ntlm>{});
+        default:
+            return f(std::type_identity<Md5Batch>{});
+        }
+    }
+
+    // Target table key of a hex digest (see BatchHasher::key())
+    inline Md5Digest keyFromHex(Algorithm algorithm, std::string_view hex)
+    {
+        return withAlgorithm(algorithm, [hex](auto hasher)
+                             {
+            using Hasher = typename decltype(hasher)::type;
+            return Hasher::key(Hasher::fromHex(hex)); });
+    }
+
+    // Characters in a hex digest of algorithm, e.g. where the ':' of a "hex:salt"
+    // target line sits
+    inline size_t hexLength(Algorithm algorithm)
+    {
+        return withAlgorithm(algorithm, [](auto hasher)
+                             {
+            using Hasher = typename decltype(hasher)::type;
+            return Hasher::DigestSize * 2; });
+    }
+
+    // Full hex digest of msg
+    inline std::string hexDigest(Algorithm algorithm, std::string_view msg)
+    {
+        return withAlgorithm(algorithm, [msg](auto hasher)
+                             {
+            using Hasher = typename decltype(hasher)::type;
+            return Hasher::toHex(Hasher::digest(msg)); });
+    }
+}
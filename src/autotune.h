@@ -0,0 +1,313 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "algorithms.h"
+#include "cracker.h"
+#include "md5_batch.h"
+#include "placement.h"
+
+namespace Tuning
+{
+    // Identifies the machine a profile was measured on: the CPU model and the
+    // number of CPUs this process may use
+    inline std::string hostSignature()
+    {
+        std::string model = "unknown";
+        std::ifstream cpuinfo("/proc/cpuinfo");
+        std::string line;
+        while (std::getline(cpuinfo, line))
+        {
+            if (line.rfind("model name", 0) == 0)
+            {
+                size_t colon = line.find(':');
+                if (colon != std::string::npos && colon + 2 <= line.size())
+                    model = line.substr(colon + 2);
+                break;
+            }
+        }
+        return model + " x" + std::to_string(Placement::allowedCpus().size());
+    }
+
+    // $XDG_CACHE_HOME/cracker/profile-<hash>, falling back to ~/.cache
+    inline std::string defaultProfilePath(Hashing::Algorithm algorithm)
+    {
+        std::string base;
+        if (const char* cache = std::getenv("XDG_CACHE_HOME"); cache != nullptr && *cache != '\0')
+            base = cache;
+        else if (const char* home = std::getenv("HOME"); home != nullptr && *home != '\0')
+            base = std::string(home) + "/.cache";
+        else
+            base = ".";
+        return base + "/cracker/profile-" + Hashing::algorithmName(algorithm);
+    }
+
+    // Fastest settings found for one host and hash function. Stored as text:
+    //
+    //   # autotune profile
+    //   host Intel(R) Xeon(R) Gold 6230 CPU @ 2.10GHz x40
+    //   hash md5
+    //   workers 38
+    //   chunk 65536
+    //   isa avx512
+    //   rate 812345678
+    struct Profile
+    {
+        std::string host;
+        Hashing::Algorithm algorithm = Hashing::Algorithm::Md5;
+        int workers = 1;
+        size_t chunk = 1 << 14;
+        Hashing::Isa isa = Hashing::Isa::Scalar;
+        // Candidates per second measured with these settings
+        double rate = 0;
+
+        void save(const std::string& path) const
+        {
+            std::filesystem::path parent = std::filesystem::path(path).parent_path();
+            if (!parent.empty())
+                std::filesystem::create_directories(parent);
+
+            std::ofstream file(path, std::ios::trunc);
+            if (!file.is_open())
+                throw std::runtime_error("Unable to open file '" + path + "'");
+
+            file << "# autotune profile\n"
+                 << "host " << host << "\n"
+                 << "hash " << Hashing::algorithmName(algorithm) << "\n"
+                 << "workers " << workers << "\n"
+                 << "chunk " << chunk << "\n"
+                 << "isa " << Hashing::Md5Batch::isaName(isa) << "\n"
+                 << "rate " << static_cast<uint64_t>(rate) << "\n";
+            file.flush();
+            if (!file)
+                throw std::runtime_error("Unable to write file '" + path + "'");
+        }
+
+        // Nothing when the file does not exist; a malformed one is an error
+        static std::optional<Profile> load(const std::string& path)
+        {
+            std::ifstream file(path);
+            if (!file.is_open())
+                return std::nullopt;
+
+            Profile profile;
+            std::string line;
+            while (std::getline(file, line))
+            {
+                if (line.empty() || line.front() == '#')
+                    continue;
+
+                size_t space = line.find(' ');
+                std::string key = line.substr(0, space);
+                std::string value = space == std::string::npos ? "" : line.substr(space + 1);
+                try
+                {
+                    if (key == "host")
+                        profile.host = value;
+                    else if (key == "hash")
+                        profile.algorithm = Hashing::parseAlgorithm(value);
+                    else if (key == "workers")
+                        profile.workers = std::stoi(value);
+                    else if (key == "chunk")
+                        profile.chunk = std::stoull(value);
+                    else if (key == "isa")
+                        profile.isa = Hashing::Md5Batch::parseIsa(value);
+                    else if (key == "rate")
+                        profile.rate = std::stod(value);
+                    else
+                        throw std::invalid_argument("unknown entry");
+                }
+                catch (const std::exception&)
+                {
+                    throw std::runtime_error("Malformed entry in profile '" + path + "': " + line);
+                }
+            }
+
+            if (profile.workers < 1 || profile.chunk == 0)
+                throw std::runtime_error("Profile '" + path + "' has no workers or chunk size.");
+            return profile;
+        }
+    };
+
+    // Repeated calibration sweeps of one setting
+    struct Trial
+    {
+        int workers;
+        size_t chunk;
+        Hashing::Isa isa;
+        // Median candidates per second over the repeats
+        double rate;
+        // Fastest minus slowest repeat
+        double spread;
+    };
+
+    // Finds the SIMD width, worker count and chunk size with the highest hash
+    // rate by timing short sweeps of the job's own keyspace, one setting at a
+    // time: the instruction set on one worker, then the worker count (powers of
+    // two up to twice the CPUs, refined around the best), then the chunk size.
+    // Every setting is swept several times, each sweep sized to take about
+    // trial_time at the rate expected from the previous ones, and compared by
+    // its median. The defaults (widest ISA, one worker per CPU, the configured
+    // chunk) are only replaced by a setting whose gain exceeds the spread of
+    // both, so noise on a busy or small host does not pick a random winner.
+    class Autotuner
+    {
+    public:
+        Autotuner(Cracking::CrackConfig job, std::chrono::milliseconds trial_time, int repeats,
+                  std::function<void(const Trial&)> report = {})
+            : job_(std::move(job)), trial_time_(trial_time), repeats_(std::max(repeats, 1)), report_(std::move(report))
+        {
+            // A target nothing hashes to, so no trial ends early
+            job_.targets = {Hashing::Md5Digest{0, 0, 0, 0}};
+            job_.targets_file.clear();
+            job_.salts.clear();
+            job_.construction = Cracking::Construction::Plain;
+            job_.engine = Cracking::Engine::Batch;
+            job_.schedule = Cracking::Schedule::Dynamic;
+            job_.checkpoint_file.clear();
+            job_.wordlist.clear();
+            job_.output_file.clear();
+            job_.progress = false;
+            job_.perf = false;
+            job_.shard = 0;
+            job_.shards = 1;
+        }
+
+        Profile tune()
+        {
+            size_t chunk = job_.min_chunk;
+            Hashing::Isa widest = Hashing::Md5Batch::detectIsa();
+
+            // Rough single-worker rate to size the trials with
+            single_rate_ = 0;
+            for (size_t range = 1 << 16; single_rate_ == 0; range *= 2)
+            {
+                double rate = run(1, chunk, widest, range);
+                if (rate * trial_time_.count() / 1e3 / 4 < range || range >= total())
+                    single_rate_ = rate;
+            }
+
+            Trial best = measure(1, chunk, widest);
+            for (Hashing::Isa isa : {Hashing::Isa::Avx512, Hashing::Isa::Avx2, Hashing::Isa::Sse2, Hashing::Isa::Scalar})
+            {
+                if (isa != widest && Hashing::Md5Batch::isSupported(isa))
+                    keep(best, measure(1, chunk, isa));
+            }
+            single_rate_ = best.rate;
+
+            std::vector<Trial> counts{best};
+            int cpus = std::max<int>(1, static_cast<int>(Placement::allowedCpus().size()));
+            for (int workers = 2; workers <= 2 * cpus; workers *= 2)
+                counts.push_back(measure(workers, chunk, best.isa));
+            if ((cpus & (cpus - 1)) != 0)
+                counts.push_back(measure(cpus, chunk, best.isa));
+            best = chooseWorkers(counts, cpus);
+
+            for (size_t size = 1 << 10; size <= (1 << 20); size *= 4)
+            {
+                if (size != chunk)
+                    keep(best, measure(best.workers, size, best.isa));
+            }
+
+            Profile profile;
+            profile.host = hostSignature();
+            profile.algorithm = job_.algorithm;
+            profile.workers = best.workers;
+            profile.chunk = best.chunk;
+            profile.isa = best.isa;
+            profile.rate = best.rate;
+            return profile;
+        }
+
+    private:
+        Cracking::CrackConfig job_;
+        std::chrono::milliseconds trial_time_;
+        int repeats_;
+        std::function<void(const Trial&)> report_;
+        double single_rate_ = 0;
+
+        Generators::Index total() const
+        {
+            return Cracking::Cracker(job_).keyspace().total();
+        }
+
+        // Halves the gap around the fastest count until its neighbours are
+        // adjacent, then keeps one worker per CPU unless another count is
+        // clearly faster
+        Trial chooseWorkers(std::vector<Trial>& counts, int cpus)
+        {
+            auto byWorkers = [](const Trial& a, const Trial& b) { return a.workers < b.workers; };
+            while (true)
+            {
+                std::sort(counts.begin(), counts.end(), byWorkers);
+                size_t top = 0;
+                for (size_t i = 0; i < counts.size(); ++i)
+                {
+                    if (counts[i].rate > counts[top].rate)
+                        top = i;
+                }
+
+                // Try the midpoint of the wider gap next to the fastest count
+                int below = top > 0 ? counts[top - 1].workers : counts[top].workers;
+                int above = top + 1 < counts.size() ? counts[top + 1].workers : counts[top].workers;
+                int middle = (counts[top].workers - below >= above - counts[top].workers) ? (below + counts[top].workers) / 2
+                                                                                          : (counts[top].workers + above) / 2;
+                if (middle == counts[top].workers || middle == below || middle == above)
+                    break;
+                counts.push_back(measure(middle, counts[top].chunk, counts[top].isa));
+            }
+
+            Trial best = *std::find_if(counts.begin(), counts.end(), [cpus](const Trial& trial) { return trial.workers == cpus; });
+            for (const Trial& trial : counts)
+                keep(best, trial);
+            return best;
+        }
+
+        // Replaces best by trial only when the gain is larger than either spread
+        static void keep(Trial& best, const Trial& trial)
+        {
+            if (trial.rate - best.rate > std::max(trial.spread, best.spread))
+                best = trial;
+        }
+
+        // Repeated sweeps, each sized to last about trial_time assuming workers
+        // scale linearly up to the CPU count
+        Trial measure(int workers, size_t chunk, Hashing::Isa isa)
+        {
+            double expected = single_rate_ * std::min(workers, std::max<int>(1, static_cast<int>(Placement::allowedCpus().size())));
+            size_t range = std::max<size_t>(static_cast<size_t>(expected * trial_time_.count() / 1e3), chunk * workers);
+
+            std::vector<double> rates;
+            for (int i = 0; i < repeats_; ++i)
+                rates.push_back(run(workers, chunk, isa, range));
+            std::sort(rates.begin(), rates.end());
+
+            Trial trial{workers, chunk, isa, rates[rates.size() / 2], rates.back() - rates.front()};
+            if (report_)
+                report_(trial);
+            return trial;
+        }
+
+        // Candidates per second of one sweep over the first range indices
+        double run(int workers, size_t chunk, Hashing::Isa isa, size_t range)
+        {
+            Cracking::CrackConfig config = job_;
+            config.num_forks = workers;
+            config.min_chunk = chunk;
+            config.isa = isa;
+            Cracking::Cracker cracker(std::move(config));
+
+            Generators::Index end = std::min<Generators::Index>(range, cracker.keyspace().total());
+            Cracking::CrackResult result = cracker.run({{0, end}});
+            return result.rate();
+        }
+    };
+}
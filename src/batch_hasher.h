@@ -0,0 +1,304 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+
+#include "hasher.h"
+#include "md5_batch.h"
+
+namespace Hashing
+{
+    // Statically dispatched multi-buffer hasher for Merkle-Damgard hashes with a
+    // 512-bit block (MD4, SHA-1, SHA-256).
+    //
+    // Derived supplies the algorithm, everything else (padding, lane packing, ISA
+    // dispatch, hex conversion) lives here, so the sweep loops call hashBatch()
+    // on a concrete type with no virtual call per candidate:
+    //
+    //   static constexpr const char* Name;
+    //   static constexpr bool BigEndian;          // word and length byte order
+    //   static constexpr bool Utf16;              // hash the message as UTF-16LE
+    //   static constexpr std::array<uint32_t, Words> IV;
+    //   template <typename V> static void compress(V* state, const V* M);
+    //
+    // compress() runs on uint32_t or a GCC vector of uint32_t, one message per
+    // lane, like Md5::compress().
+    template <typename Derived, size_t Words>
+    class BatchHasher
+    {
+    public:
+        typedef std::array<uint32_t, Words> Digest;
+
+        static constexpr size_t MaxLanes = Md5Batch::MaxLanes;
+        static constexpr size_t DigestSize = Words * 4;
+
+        explicit BatchHasher(Isa isa = Md5Batch::detectIsa())
+            : isa_(isa), lanes_(Md5Batch::laneCount(isa))
+        {
+            if (!Md5Batch::isSupported(isa_))
+                throw std::invalid_argument(std::string("Instruction set not supported by this CPU: ") + Md5Batch::isaName(isa_));
+        }
+
+        Isa isa() const
+        {
+            return isa_;
+        }
+
+        size_t lanes() const
+        {
+            return lanes_;
+        }
+
+        // Longest message (in input bytes) that fits one block with its padding
+        static constexpr size_t maxMessageSize()
+        {
+            return Derived::Utf16 ? 27 : 55;
+        }
+
+        // Hashes count messages into out[0..count); longer messages than
+        // maxMessageSize() take the scalar path
+        void hashBatch(const std::string_view* msgs, size_t count, Digest* out) const
+        {
+            alignas(64) uint32_t words[16 * MaxLanes];
+            Digest digests[MaxLanes];
+            size_t slot_of[MaxLanes];
+
+            size_t i = 0;
+            while (i < count)
+            {
+                std::memset(words, 0, sizeof(words));
+                size_t used = 0;
+                for (; i < count && used < lanes_; ++i)
+                {
+                    if (msgs[i].size() > maxMessageSize())
+                    {
+                        out[i] = digest(msgs[i]);
+                        continue;
+                    }
+                    packMessage(msgs[i], words, MaxLanes, used);
+                    slot_of[used++] = i;
+                }
+
+                if (used == 0)
+                    continue;
+
+                hashBlock(words, MaxLanes, digests);
+                for (size_t lane = 0; lane < used; ++lane)
+                    out[slot_of[lane]] = digests[lane];
+            }
+        }
+
+        // Hashes one pre-padded block per lane; word j of lane l is words[j * stride + l]
+        void hashBlock(const uint32_t* words, size_t stride, Digest* out) const
+        {
+            switch (isa_)
+            {
+#if HASHING_X86
+            case Isa::Avx512:
+                compressAvx512(words, stride, out);
+                return;
+            case Isa::Avx2:
+                compressAvx2(words, stride, out);
+                return;
+            case Isa::Sse2:
+                compressSse2(words, stride, out);
+                return;
+#endif
+            default:
+                compressScalar(words, stride, out);
+                return;
+            }
+        }
+
+        // Writes msg, the terminator and the bit length into lane of a zeroed block
+        static void packMessage(std::string_view msg, uint32_t* words, size_t stride, size_t lane)
+        {
+            size_t width = Derived::Utf16 ? 2 : 1;
+            for (size_t i = 0; i < msg.size(); ++i)
+                words[wordOf(i * width) * stride + lane] |= static_cast<uint32_t>(static_cast<uint8_t>(msg[i])) << shiftOf(i * width);
+
+            size_t bytes = msg.size() * width;
+            words[wordOf(bytes) * stride + lane] |= 0x80u << shiftOf(bytes);
+            words[(Derived::BigEndian ? 15 : 14) * stride + lane] = static_cast<uint32_t>(bytes * 8);
+        }
+
+        // Scalar digest of a message of any length
+        static Digest digest(std::string_view msg)
+        {
+            std::string wide;
+            if constexpr (Derived::Utf16)
+            {
+                wide.resize(msg.size() * 2, '\0');
+                for (size_t i = 0; i < msg.size(); ++i)
+                    wide[i * 2] = msg[i];
+                msg = wide;
+            }
+
+            Digest state = Derived::IV;
+            uint32_t M[16];
+
+            size_t offset = 0;
+            for (; offset + 64 <= msg.size(); offset += 64)
+            {
+                loadWords(msg.data() + offset, M);
+                Derived::compress(state.data(), M);
+            }
+
+            uint8_t tail[128] = {};
+            size_t rest = msg.size() - offset;
+            std::memcpy(tail, msg.data() + offset, rest);
+            tail[rest] = 0x80;
+
+            size_t blocks = (rest <= 55) ? 1 : 2;
+            uint64_t bits = static_cast<uint64_t>(msg.size()) * 8;
+            for (size_t i = 0; i < 8; ++i)
+                tail[blocks * 64 - 8 + i] = static_cast<uint8_t>(bits >> ((Derived::BigEndian ? 7 - i : i) * 8));
+
+            for (size_t block = 0; block < blocks; ++block)
+            {
+                loadWords(reinterpret_cast<const char*>(tail) + block * 64, M);
+                Derived::compress(state.data(), M);
+            }
+            return state;
+        }
+
+        // Canonical byte form of a digest
+        static std::array<uint8_t, DigestSize> toBytes(const Digest& digest)
+        {
+            std::array<uint8_t, DigestSize> bytes;
+            for (size_t i = 0; i < DigestSize; ++i)
+                bytes[i] = static_cast<uint8_t>(digest[i / 4] >> shiftOf(i));
+            return bytes;
+        }
+
+        static std::string toHex(const Digest& digest)
+        {
+            static constexpr char hex[] = "0123456789abcdef";
+            std::array<uint8_t, DigestSize> bytes = toBytes(digest);
+            std::string result(DigestSize * 2, '0');
+            for (size_t i = 0; i < DigestSize; ++i)
+            {
+                result[i * 2] = hex[bytes[i] >> 4];
+                result[i * 2 + 1] = hex[bytes[i] & 0x0F];
+            }
+            return result;
+        }
+
+        static Digest fromHex(std::string_view hex)
+        {
+            if (hex.size() != DigestSize * 2)
+            {
+                throw std::invalid_argument(std::string(Derived::Name) + " digest must be " + std::to_string(DigestSize * 2) +
+                                            " hex characters: '" + std::string(hex) + "'.");
+            }
+
+            Digest digest = {};
+            for (size_t i = 0; i < hex.size(); ++i)
+            {
+                char c = hex[i];
+                uint32_t nibble;
+                if (c >= '0' && c <= '9')
+                    nibble = c - '0';
+                else if (c >= 'a' && c <= 'f')
+                    nibble = c - 'a' + 10;
+                else if (c >= 'A' && c <= 'F')
+                    nibble = c - 'A' + 10;
+                else
+                    throw std::invalid_argument(std::string(Derived::Name) + " digest contains a non-hex character: '" + std::string(hex) + "'.");
+
+                // Byte i / 2 of the digest; the high nibble comes first
+                size_t byte = i / 2;
+                digest[byte / 4] |= nibble << (shiftOf(byte) + ((i % 2) ? 0 : 4));
+            }
+            return digest;
+        }
+
+        // Lookup key of a digest: its first 16 bytes in Md5Digest form, so the same
+        // target table (see Hashing::keyFromHex()) serves every algorithm
+        static Md5Digest key(const Digest& digest)
+        {
+            Md5Digest key;
+            for (size_t k = 0; k < 4; ++k)
+                key[k] = Derived::BigEndian ? __builtin_bswap32(digest[k]) : digest[k];
+            return key;
+        }
+
+    private:
+        Isa isa_;
+        size_t lanes_;
+
+        static constexpr size_t wordOf(size_t byte)
+        {
+            return byte / 4;
+        }
+
+        // Bit offset of a byte within its word
+        static constexpr uint32_t shiftOf(size_t byte)
+        {
+            return static_cast<uint32_t>((Derived::BigEndian ? 3 - byte % 4 : byte % 4) * 8);
+        }
+
+        static void loadWords(const char* chunk, uint32_t* M)
+        {
+            for (size_t i = 0; i < 16; ++i)
+            {
+                M[i] = 0;
+                for (size_t b = 0; b < 4; ++b)
+                    M[i] |= static_cast<uint32_t>(static_cast<uint8_t>(chunk[i * 4 + b])) << shiftOf(b);
+            }
+        }
+
+        template <typename V>
+        [[gnu::always_inline]] static inline void compressLanes(const uint32_t* words, size_t stride, Digest* out)
+        {
+            constexpr size_t lanes = sizeof(V) / sizeof(uint32_t);
+
+            V M[16];
+            for (size_t j = 0; j < 16; ++j)
+                std::memcpy(&M[j], words + j * stride, sizeof(V));
+
+            V state[Words];
+            for (size_t k = 0; k < Words; ++k)
+                state[k] = V{} + Derived::IV[k];
+
+            Derived::compress(state, M);
+
+            for (size_t lane = 0; lane < lanes; ++lane)
+            {
+                for (size_t k = 0; k < Words; ++k)
+                    out[lane][k] = state[k][lane];
+            }
+        }
+
+        static void compressScalar(const uint32_t* words, size_t stride, Digest* out)
+        {
+            uint32_t M[16];
+            for (size_t j = 0; j < 16; ++j)
+                M[j] = words[j * stride];
+
+            out[0] = Derived::IV;
+            Derived::compress(out[0].data(), M);
+        }
+
+#if HASHING_X86
+        [[gnu::target("sse2")]] static void compressSse2(const uint32_t* words, size_t stride, Digest* out)
+        {
+            compressLanes<Lanes4>(words, stride, out);
+        }
+
+        [[gnu::target("avx2")]] static void compressAvx2(const uint32_t* words, size_t stride, Digest* out)
+        {
+            compressLanes<Lanes8>(words, stride, out);
+        }
+
+        [[gnu::target("avx512f")]] static void compressAvx512(const uint32_t* words, size_t stride, Digest* out)
+        {
+            compressLanes<Lanes16>(words, stride, out);
+        }
+#endif
+    };
+}
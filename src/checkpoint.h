@@ -0,0 +1,256 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <stop_token>
+#include <thread>
+#include <stdexcept>
+
+#include "generator.h"
+#include "keyspace.h"
+#include "traversal.h"
+#include "scheduler.h"
+
+namespace Recovery
+{
+    // Unfinished part of a keyspace sweep.
+    //
+    // Stored as text, one "range <begin> <end>" line per half-open index range,
+    // followed by the first candidate of the range for humans:
+    //
+    //   # keyspace checkpoint
+    //   size 7
+    //   charset abcdefghijklmnopqrstuvwxyz
+    //   range 1234 5678 aaaabvm
+    //
+    // A masked keyspace has a "mask ?u?l?l?d?d" line instead of the charset, and
+    // a sweep over several lengths adds "min-size 4"; indices are then global.
+    // A sweep out of order adds "order random 1234" (the name and the seed), and
+    // its ranges are positions of that traversal rather than candidate indices.
+    struct Checkpoint
+    {
+        size_t size = 0;
+        // Shortest length of a variable-length sweep; 0 when only size is swept
+        size_t min_size = 0;
+        std::string charset;
+        std::string mask;
+        Generators::Order order = Generators::Order::Linear;
+        uint64_t seed = 0;
+        std::vector<LoadBalancing::Range> ranges;
+
+        Generators::Keyspace keyspace() const
+        {
+            size_t min = (min_size == 0) ? size : min_size;
+            if (mask.empty())
+                return Generators::Keyspace(min, size, charset);
+            return Generators::Keyspace(Generators::Mask::parse(mask), min);
+        }
+
+        Generators::Traversal traversal() const
+        {
+            return Generators::Traversal(order, keyspace().total(), seed);
+        }
+
+        // Indices left to sweep
+        Generators::Index remaining() const
+        {
+            Generators::Index sum = 0;
+            for (const LoadBalancing::Range& range : ranges)
+                sum += range.size();
+            return sum;
+        }
+
+        // Sorts the ranges and merges overlapping or touching ones
+        void normalize()
+        {
+            ranges.erase(std::remove_if(ranges.begin(), ranges.end(), [](const LoadBalancing::Range& r) { return r.end <= r.begin; }),
+                         ranges.end());
+            std::sort(ranges.begin(), ranges.end(), [](const LoadBalancing::Range& a, const LoadBalancing::Range& b)
+                      { return a.begin < b.begin; });
+
+            std::vector<LoadBalancing::Range> merged;
+            for (const LoadBalancing::Range& range : ranges)
+            {
+                if (!merged.empty() && range.begin <= merged.back().end)
+                    merged.back().end = std::max(merged.back().end, range.end);
+                else
+                    merged.push_back(range);
+            }
+            ranges = std::move(merged);
+        }
+
+        // Writes to a temporary file and renames it over path, so a crash never
+        // leaves a half-written checkpoint behind
+        void save(const std::string& path) const
+        {
+            std::string temporary = path + ".tmp";
+            {
+                std::ofstream file(temporary, std::ios::trunc);
+                if (!file.is_open())
+                    throw std::runtime_error("Unable to open file '" + temporary + "'");
+
+                file << "# keyspace checkpoint\n"
+                     << "size " << size << "\n";
+                if (min_size != 0 && min_size != size)
+                    file << "min-size " << min_size << "\n";
+                if (mask.empty())
+                    file << "charset " << charset << "\n";
+                else
+                    file << "mask " << mask << "\n";
+                if (order != Generators::Order::Linear)
+                    file << "order " << Generators::orderName(order) << " " << seed << "\n";
+
+                Generators::Keyspace space = keyspace();
+                Generators::Traversal positions = traversal();
+                for (const LoadBalancing::Range& range : ranges)
+                {
+                    file << "range " << Generators::toDecimal(range.begin) << " " << Generators::toDecimal(range.end) << " "
+                         << space.toString(positions.indexOf(range.begin)) << "\n";
+                }
+
+                file.flush();
+                if (!file)
+                    throw std::runtime_error("Unable to write file '" + temporary + "'");
+            }
+
+            if (std::rename(temporary.c_str(), path.c_str()) != 0)
+                throw std::runtime_error("Unable to replace file '" + path + "': " + strerror(errno));
+        }
+
+        static Checkpoint load(const std::string& path)
+        {
+            std::ifstream file(path);
+            if (!file.is_open())
+                throw std::runtime_error("Unable to open file '" + path + "'");
+
+            Checkpoint checkpoint;
+            std::string line;
+            while (std::getline(file, line))
+            {
+                if (line.empty() || line.front() == '#')
+                    continue;
+
+                // The charset and the mask may contain spaces, so they are the rest of their line
+                if (line.rfind("charset ", 0) == 0)
+                {
+                    checkpoint.charset = line.substr(8);
+                    continue;
+                }
+                if (line.rfind("mask ", 0) == 0)
+                {
+                    checkpoint.mask = line.substr(5);
+                    continue;
+                }
+
+                std::istringstream fields(line);
+                std::string key;
+                fields >> key;
+                if (key == "size")
+                    fields >> checkpoint.size;
+                else if (key == "min-size")
+                    fields >> checkpoint.min_size;
+                else if (key == "order")
+                {
+                    std::string name;
+                    fields >> name >> checkpoint.seed;
+                    try
+                    {
+                        checkpoint.order = Generators::parseOrder(name);
+                    }
+                    catch (const std::exception&)
+                    {
+                        throw std::runtime_error("Malformed entry in checkpoint '" + path + "': " + line);
+                    }
+                }
+                else if (key == "range")
+                {
+                    // Bounds may exceed 64 bits, so they are parsed by hand
+                    std::string begin, end;
+                    fields >> begin >> end;
+                    try
+                    {
+                        checkpoint.ranges.push_back({Generators::parseIndex(begin), Generators::parseIndex(end)});
+                    }
+                    catch (const std::exception&)
+                    {
+                        throw std::runtime_error("Malformed range in checkpoint '" + path + "': " + line);
+                    }
+                    continue;
+                }
+                else
+                    throw std::runtime_error("Unknown entry in checkpoint '" + path + "': " + line);
+
+                if (fields.fail())
+                    throw std::runtime_error("Malformed entry in checkpoint '" + path + "': " + line);
+            }
+
+            if (checkpoint.size == 0 || (checkpoint.charset.empty() && checkpoint.mask.empty()))
+                throw std::runtime_error("Checkpoint '" + path + "' is missing the size or the charset.");
+
+            Generators::Index total = checkpoint.keyspace().total();
+            for (const LoadBalancing::Range& range : checkpoint.ranges)
+            {
+                if (range.end > total || range.begin > range.end)
+                    throw std::runtime_error("Checkpoint '" + path + "' has a range outside the keyspace.");
+            }
+
+            checkpoint.normalize();
+            return checkpoint;
+        }
+    };
+
+    // Parent-side thread that saves snapshot() to path every interval, off the
+    // workers' hot loop. A last checkpoint is written when it is destroyed.
+    class CheckpointWriter
+    {
+    public:
+        CheckpointWriter(std::string path, std::chrono::milliseconds interval, std::function<Checkpoint()> snapshot)
+            : path_(std::move(path)), snapshot_(std::move(snapshot)),
+              thread_([this, interval](std::stop_token token) { loop(token, interval); })
+        {
+        }
+
+        ~CheckpointWriter()
+        {
+            thread_.request_stop();
+            thread_.join();
+            write();
+        }
+
+    private:
+        std::string path_;
+        std::function<Checkpoint()> snapshot_;
+        std::mutex mutex_;
+        std::condition_variable_any wake_;
+        std::jthread thread_;
+
+        void loop(std::stop_token token, std::chrono::milliseconds interval)
+        {
+            std::unique_lock lock(mutex_);
+            while (!wake_.wait_for(lock, token, interval, []() { return false; }) && !token.stop_requested())
+                write();
+        }
+
+        void write()
+        {
+            try
+            {
+                snapshot_().save(path_);
+            }
+            catch (const std::exception& ex)
+            {
+                fprintf(stderr, "\nCheckpoint failed: %s\n", ex.what());
+            }
+        }
+    };
+}
@@ -0,0 +1,636 @@
+#pragma once
+
+#include <poll.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <iostream>
+#include <stdexcept>
+
+#include "cracker.h"
+#include "transport.h"
+
+namespace Cluster
+{
+    // Coordinator and worker nodes talk in text lines.
+    //
+    // On connect the coordinator describes the job in the checkpoint format
+    // ("size", "min-size", "charset" or "mask", "order") plus "hash <algorithm>", then
+    // sends one "target <hex>" line per target table key and "end". A node then repeats
+    //
+    //   node:        lease
+    //   coordinator: range <id> <begin> <end>  |  wait  |  finish
+    //   node:        match <hex> <index>        (as soon as a key is found)
+    //   coordinator: stop                       (once every target is found)
+    //   node:        done <id> <processed> <milliseconds>
+    //
+    // and sends "alive" every heartbeat interval from a separate thread, so a node
+    // that stops talking (crashed, hung or cut off) is dropped and its leases are
+    // handed to the others. A node that gets "stop" ends its lease early and still
+    // reports it as done, so the coordinator's totals count what it swept.
+
+    struct CoordinatorConfig
+    {
+        // Keyspace and targets of the job; the worker settings are the nodes' business
+        Cracking::CrackConfig job;
+        // "tcp:HOST:PORT" or "unix:PATH"
+        std::string address;
+        // Indices handed out per lease
+        Generators::Index lease_size = Generators::Index{1} << 28;
+        // A node silent for this long is considered dead
+        std::chrono::milliseconds node_timeout{15000};
+        // How long busy nodes get to report their stopped leases once the job is over
+        std::chrono::milliseconds drain_timeout{2000};
+        // Print node arrivals, departures and matches to stderr
+        bool verbose = true;
+    };
+
+    struct NodeStats
+    {
+        std::string name;
+        size_t leases = 0;
+        uint64_t processed = 0;
+        double busy_ms = 0;
+        // Leases taken away after the node disappeared
+        size_t lost = 0;
+
+        // Hashes per second while the node was sweeping
+        double rate() const
+        {
+            return busy_ms > 0 ? processed / (busy_ms / 1e3) : 0;
+        }
+    };
+
+    struct ClusterResult
+    {
+        std::vector<Cracking::Match> matches;
+        Generators::Index total = 0;
+        double elapsed_ms = 0;
+        std::vector<NodeStats> nodes;
+
+        uint64_t processed() const
+        {
+            uint64_t sum = 0;
+            for (const NodeStats& node : nodes)
+                sum += node.processed;
+            return sum;
+        }
+
+        // Hashes per second over the whole job, 0 when it ended instantly
+        double rate() const
+        {
+            return elapsed_ms > 0 ? processed() / (elapsed_ms / 1e3) : 0;
+        }
+    };
+
+    // Splits the keyspace into leases and hands them to the nodes that connect
+    // until every index is swept or every target is found. Runs single-threaded
+    // on poll(); the job's Cracker is only used to describe the keyspace and
+    // the target set, never to sweep.
+    class Coordinator
+    {
+    public:
+        explicit Coordinator(CoordinatorConfig config, std::unique_ptr<Network::ITransport> transport = std::make_unique<Network::SocketTransport>())
+            : config_(std::move(config)), transport_(std::move(transport)), job_(config_.job)
+        {
+            if (config_.lease_size == 0 || config_.lease_size > std::numeric_limits<size_t>::max())
+                throw std::invalid_argument("Lease size must be between 1 and 2^64 - 1.");
+
+            std::vector<LoadBalancing::Range> ranges = config_.job.ranges;
+            if (ranges.empty())
+                ranges.push_back(LoadBalancing::slice({0, job_.keyspace().total()}, config_.job.shard, config_.job.shards));
+            for (const LoadBalancing::Range& range : ranges)
+            {
+                if (range.end > range.begin)
+                    pending_.push_back(range);
+                total_ += range.size();
+            }
+        }
+
+        const Cracking::Cracker& job() const
+        {
+            return job_;
+        }
+
+        ClusterResult run()
+        {
+            std::unique_ptr<Network::IListener> listener = transport_->listen(config_.address);
+            start_time_ = std::chrono::steady_clock::now();
+            log("Listening on " + config_.address);
+
+            while (!finished())
+                step(*listener, std::chrono::milliseconds(500));
+
+            // Every target is found: stop the nodes still sweeping and wait a little
+            // for their reports, which now come back quickly
+            std::set<size_t> busy;
+            for (const auto& [lease, held] : leases_)
+                busy.insert(held.node);
+            for (size_t id : busy)
+            {
+                if (connections_.count(id) != 0)
+                    trySend(id, "stop");
+            }
+            auto deadline = std::chrono::steady_clock::now() + config_.drain_timeout;
+            while (!leases_.empty() && !connections_.empty())
+            {
+                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+                if (left.count() <= 0)
+                    break;
+                step(*listener, std::min(left, std::chrono::milliseconds(500)));
+            }
+
+            // Nodes that are idle or did not report in time see "finish" next
+            for (auto& [id, connection] : connections_)
+                trySend(id, "finish");
+            connections_.clear();
+
+            ClusterResult result;
+            result.total = total_;
+            result.elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time_).count();
+            result.matches = matches_;
+            for (const Node& node : nodes_)
+                result.nodes.push_back(node.stats);
+            return result;
+        }
+
+    private:
+        struct Node
+        {
+            NodeStats stats;
+            std::chrono::steady_clock::time_point last_seen;
+        };
+
+        struct Lease
+        {
+            LoadBalancing::Range range;
+            size_t node;
+        };
+
+        CoordinatorConfig config_;
+        std::unique_ptr<Network::ITransport> transport_;
+        Cracking::Cracker job_;
+        Generators::Index total_ = 0;
+        std::chrono::steady_clock::time_point start_time_;
+
+        // Work not leased yet; ranges of lost leases go to the front
+        std::deque<LoadBalancing::Range> pending_;
+        std::map<uint64_t, Lease> leases_;
+        uint64_t next_lease_ = 0;
+
+        // Every node ever seen, indexed by node id; only live ones have a connection
+        std::vector<Node> nodes_;
+        std::map<size_t, std::unique_ptr<Network::IConnection>> connections_;
+
+        std::vector<Cracking::Match> matches_;
+        std::set<Hashing::Md5Digest> found_;
+
+        // Waits up to timeout for activity and serves it
+        void step(Network::IListener& listener, std::chrono::milliseconds timeout)
+        {
+            std::vector<pollfd> fds{{listener.handle(), POLLIN, 0}};
+            std::vector<size_t> ids;
+            for (const auto& [id, connection] : connections_)
+            {
+                fds.push_back({connection->handle(), POLLIN, 0});
+                ids.push_back(id);
+            }
+
+            if (::poll(fds.data(), fds.size(), static_cast<int>(timeout.count())) < 0 && errno != EINTR)
+                throw std::runtime_error(std::string("Poll failed: ") + strerror(errno));
+
+            if (fds[0].revents & POLLIN)
+                accept(listener);
+            for (size_t i = 1; i < fds.size(); ++i)
+            {
+                if (fds[i].revents != 0)
+                    serve(ids[i - 1]);
+            }
+            expire();
+        }
+
+        bool finished() const
+        {
+            return found_.size() >= job_.targetCount() || (pending_.empty() && leases_.empty());
+        }
+
+        void accept(Network::IListener& listener)
+        {
+            size_t id = nodes_.size();
+            nodes_.push_back({{}, std::chrono::steady_clock::now()});
+            nodes_[id].stats.name = "node" + std::to_string(id);
+            connections_[id] = listener.accept();
+
+            // Describe the job
+            std::vector<std::string> lines{"size " + std::to_string(job_.keyspace().maxSize()),
+                                           std::string("hash ") + Hashing::algorithmName(config_.job.algorithm)};
+            if (job_.keyspace().minSize() != job_.keyspace().maxSize())
+                lines.push_back("min-size " + std::to_string(job_.keyspace().minSize()));
+            if (config_.job.mask.empty())
+                lines.push_back("charset " + config_.job.charset);
+            else
+                lines.push_back("mask " + config_.job.mask);
+            if (config_.job.order != Generators::Order::Linear)
+                lines.push_back(std::string("order ") + Generators::orderName(config_.job.order) + " " + std::to_string(config_.job.seed));
+            job_.targets().forEach([&lines](const Hashing::Md5Digest& digest)
+                                   { lines.push_back("target " + Hashing::Md5::toHex(digest)); });
+            lines.push_back("end");
+
+            for (const std::string& line : lines)
+            {
+                if (!trySend(id, line))
+                    return;
+            }
+        }
+
+        // Handles everything a node has sent; drops it once the connection is gone
+        void serve(size_t id)
+        {
+            auto connection = connections_.find(id);
+            if (connection == connections_.end())
+                return;
+
+            std::vector<std::string> lines;
+            bool open = connection->second->receiveAvailable(lines);
+            nodes_[id].last_seen = std::chrono::steady_clock::now();
+            for (const std::string& line : lines)
+            {
+                if (connections_.count(id) == 0)
+                    return;
+                try
+                {
+                    handle(id, line);
+                }
+                catch (const std::exception& ex)
+                {
+                    log(ex.what());
+                    drop(id, "dropped");
+                    return;
+                }
+            }
+
+            if (!open)
+                drop(id, "disconnected");
+        }
+
+        void handle(size_t id, const std::string& line)
+        {
+            NodeStats& stats = nodes_[id].stats;
+            std::istringstream fields(line);
+            std::string command;
+            fields >> command;
+
+            if (command == "hello")
+            {
+                std::string name;
+                fields >> name;
+                if (!name.empty())
+                    stats.name = name;
+                log("Node " + stats.name + " joined");
+            }
+            else if (command == "lease")
+            {
+                if (found_.size() >= job_.targetCount())
+                    trySend(id, "finish");
+                else if (pending_.empty())
+                    trySend(id, leases_.empty() ? "finish" : "wait");
+                else
+                {
+                    LoadBalancing::Range& front = pending_.front();
+                    LoadBalancing::Range range{front.begin, front.begin + std::min(front.size(), config_.lease_size)};
+                    front.begin = range.end;
+                    if (front.begin == front.end)
+                        pending_.pop_front();
+
+                    uint64_t lease = next_lease_++;
+                    leases_[lease] = {range, id};
+                    trySend(id, "range " + std::to_string(lease) + " " + Generators::toDecimal(range.begin) + " " + Generators::toDecimal(range.end));
+                }
+            }
+            else if (command == "match")
+            {
+                std::string hex, index;
+                fields >> hex >> index;
+                Cracking::Match match{Hashing::Md5::fromHex(hex), Generators::parseIndex(index), elapsedNs()};
+
+                // A key is only accepted if it really hashes to a wanted digest
+                if (!job_.targets().contains(match.digest) || match.index >= job_.keyspace().total() ||
+                    Hashing::keyFromHex(config_.job.algorithm, job_.digestOf(match)) != match.digest)
+                    throw std::runtime_error("Node " + stats.name + " reported a bogus match: " + line);
+
+                if (found_.insert(match.digest).second)
+                {
+                    matches_.push_back(match);
+                    log("Node " + stats.name + " found " + job_.digestOf(match) + ":" + job_.keyOf(match));
+                }
+            }
+            else if (command == "done")
+            {
+                uint64_t lease;
+                uint64_t processed;
+                double ms;
+                fields >> lease >> processed >> ms;
+
+                // Late reports of a lease that was already handed to someone else are
+                // ignored, so its candidates are only counted once
+                auto it = leases_.find(lease);
+                if (it != leases_.end() && it->second.node == id)
+                {
+                    leases_.erase(it);
+                    ++stats.leases;
+                    stats.processed += processed;
+                    stats.busy_ms += ms;
+                }
+            }
+            else if (command != "alive")
+                throw std::runtime_error("Node " + stats.name + " sent an unknown message: " + line);
+        }
+
+        // Drops nodes that have been silent for longer than the timeout
+        void expire()
+        {
+            auto now = std::chrono::steady_clock::now();
+            std::vector<size_t> silent;
+            for (const auto& [id, connection] : connections_)
+            {
+                if (now - nodes_[id].last_seen > config_.node_timeout)
+                    silent.push_back(id);
+            }
+            for (size_t id : silent)
+                drop(id, "timed out");
+        }
+
+        // Closes the connection and puts the node's leases back in front of the queue
+        void drop(size_t id, const std::string& reason)
+        {
+            connections_.erase(id);
+            for (auto it = leases_.begin(); it != leases_.end();)
+            {
+                if (it->second.node == id)
+                {
+                    pending_.push_front(it->second.range);
+                    ++nodes_[id].stats.lost;
+                    it = leases_.erase(it);
+                }
+                else
+                    ++it;
+            }
+            log("Node " + nodes_[id].stats.name + " " + reason +
+                (nodes_[id].stats.lost != 0 ? ", " + std::to_string(nodes_[id].stats.lost) + " leases re-queued" : ""));
+        }
+
+        bool trySend(size_t id, const std::string& line)
+        {
+            try
+            {
+                connections_.at(id)->send(line);
+                return true;
+            }
+            catch (const std::runtime_error&)
+            {
+                drop(id, "disconnected");
+                return false;
+            }
+        }
+
+        void log(const std::string& message) const
+        {
+            if (config_.verbose)
+                std::cerr << "[coordinator] " << message << std::endl;
+        }
+
+        uint64_t elapsedNs() const
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_time_).count();
+        }
+    };
+
+    struct NodeConfig
+    {
+        // Local parallelism: forks or threads, engine, chunking etc.; the
+        // keyspace and targets come from the coordinator
+        Cracking::CrackConfig local;
+        std::string address;
+        std::string name;
+        // How long to keep retrying while the coordinator is not up yet
+        std::chrono::milliseconds connect_timeout{10000};
+        std::chrono::milliseconds heartbeat{2000};
+        // Adjusts the local settings once the job is known, e.g. to the tuned
+        // profile of its hash function
+        std::function<void(Cracking::CrackConfig&)> configure;
+    };
+
+    struct NodeResult
+    {
+        size_t leases = 0;
+        uint64_t processed = 0;
+        size_t matches = 0;
+    };
+
+    // Worker node: sweeps the leases it is given with a local Cracker, so each
+    // lease runs across this machine's LoadBalancer workers
+    class Node
+    {
+    public:
+        explicit Node(NodeConfig config, std::unique_ptr<Network::ITransport> transport = std::make_unique<Network::SocketTransport>())
+            : config_(std::move(config)), transport_(std::move(transport))
+        {
+            if (config_.name.empty())
+            {
+                char host[256] = {};
+                gethostname(host, sizeof(host) - 1);
+                config_.name = std::string(host) + ":" + std::to_string(getpid());
+            }
+        }
+
+        NodeResult run()
+        {
+            connection_ = connect();
+            if (!send("hello " + config_.name))
+                throw std::runtime_error("Coordinator closed the connection.");
+
+            Cracking::CrackConfig config = config_.local;
+            readJob(config);
+            if (config_.configure)
+                config_.configure(config);
+            config.schedule = Cracking::Schedule::Dynamic;
+            config.ranges.clear();
+            config.checkpoint_file.clear();
+            config.shard = 0;
+            config.shards = 1;
+            // Forked workers would otherwise keep the connection open after this
+            // process dies, delaying the coordinator re-leasing its work
+            config.workers.close_in_child.push_back(connection_->handle());
+            config.monitor = [this](const std::vector<Cracking::Match>& matches) { return relay(matches); };
+            Cracking::Cracker cracker(std::move(config));
+
+            std::jthread heartbeat([this](std::stop_token token) { beat(token); });
+
+            NodeResult result;
+            std::string line;
+            while (true)
+            {
+                if (!send("lease") || !connection_->receive(line))
+                    break;
+
+                std::istringstream fields(line);
+                std::string command;
+                fields >> command;
+                if (command == "wait")
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+                    continue;
+                }
+                if (command != "range")
+                    break;
+
+                uint64_t lease;
+                std::string begin, end;
+                fields >> lease >> begin >> end;
+                Cracking::CrackResult swept = cracker.run({{Generators::parseIndex(begin), Generators::parseIndex(end)}});
+
+                ++result.leases;
+                result.processed += swept.processed();
+                result.matches += swept.matches.size();
+
+                // The matches went out while sweeping; the coordinator may already be
+                // gone once the last target was found elsewhere
+                if (!send("done " + std::to_string(lease) + " " + std::to_string(swept.processed()) + " " + std::to_string(swept.elapsed_ms)))
+                    break;
+            }
+            return result;
+        }
+
+    private:
+        NodeConfig config_;
+        std::unique_ptr<Network::ITransport> transport_;
+        std::unique_ptr<Network::IConnection> connection_;
+        // Serialises the main loop's messages with the heartbeat's
+        std::mutex send_mutex_;
+        // Set by relay() once the coordinator has ended the job
+        bool stopped_ = false;
+
+        std::unique_ptr<Network::IConnection> connect()
+        {
+            auto deadline = std::chrono::steady_clock::now() + config_.connect_timeout;
+            while (true)
+            {
+                try
+                {
+                    return transport_->connect(config_.address);
+                }
+                catch (const std::runtime_error&)
+                {
+                    if (std::chrono::steady_clock::now() >= deadline)
+                        throw;
+                    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+                }
+            }
+        }
+
+        // Reads the job description up to the "end" line
+        void readJob(Cracking::CrackConfig& config)
+        {
+            config.size = 0;
+            config.min_size = 0;
+            config.charset.clear();
+            config.mask.clear();
+            config.targets.clear();
+            config.targets_file.clear();
+            config.algorithm = Hashing::Algorithm::Md5;
+            config.order = Generators::Order::Linear;
+            config.seed = 0;
+
+            std::string line;
+            while (true)
+            {
+                if (!connection_->receive(line))
+                    throw std::runtime_error("Coordinator closed the connection before sending the job.");
+                if (line == "end")
+                    break;
+
+                if (line.rfind("charset ", 0) == 0)
+                    config.charset = line.substr(8);
+                else if (line.rfind("mask ", 0) == 0)
+                    config.mask = line.substr(5);
+                else if (line.rfind("target ", 0) == 0)
+                    config.targets.push_back(Hashing::Md5::fromHex(line.substr(7)));
+                else if (line.rfind("size ", 0) == 0)
+                    config.size = std::stoul(line.substr(5));
+                else if (line.rfind("hash ", 0) == 0)
+                    config.algorithm = Hashing::parseAlgorithm(line.substr(5));
+                else if (line.rfind("min-size ", 0) == 0)
+                    config.min_size = std::stoul(line.substr(9));
+                else if (line.rfind("order ", 0) == 0)
+                {
+                    std::istringstream fields(line.substr(6));
+                    std::string name;
+                    fields >> name >> config.seed;
+                    config.order = Generators::parseOrder(name);
+                }
+                else
+                    throw std::runtime_error("Unknown job entry from coordinator: " + line);
+            }
+        }
+
+        // Returns false once the coordinator has gone away
+        bool send(const std::string& line)
+        {
+            std::lock_guard lock(send_mutex_);
+            try
+            {
+                connection_->send(line);
+                return true;
+            }
+            catch (const std::runtime_error&)
+            {
+                return false;
+            }
+        }
+
+        // Cracker monitor: sends the new matches and checks for a "stop" while a
+        // lease is swept; the main loop does not read from the connection then
+        bool relay(const std::vector<Cracking::Match>& matches)
+        {
+            for (const Cracking::Match& match : matches)
+            {
+                if (!send("match " + Hashing::Md5::toHex(match.digest) + " " + Generators::toDecimal(match.index)))
+                    stopped_ = true;
+            }
+
+            pollfd fd{connection_->handle(), POLLIN, 0};
+            if (!stopped_ && ::poll(&fd, 1, 0) > 0)
+            {
+                std::vector<std::string> lines;
+                bool open = connection_->receiveAvailable(lines);
+                for (const std::string& line : lines)
+                    stopped_ = stopped_ || line == "stop" || line == "finish";
+                stopped_ = stopped_ || !open;
+            }
+            return !stopped_;
+        }
+
+        void beat(std::stop_token token)
+        {
+            std::mutex mutex;
+            std::condition_variable_any wake;
+            std::unique_lock lock(mutex);
+            while (!wake.wait_for(lock, token, config_.heartbeat, []() { return false; }) && !token.stop_requested())
+            {
+                if (!send("alive"))
+                    return;
+            }
+        }
+    };
+}
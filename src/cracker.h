@@ -0,0 +1,969 @@
+#pragma once
+
+#include <unistd.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <new>
+#include <optional>
+#include <set>
+#include <fstream>
+#include <type_traits>
+#include <thread>
+#include <stdexcept>
+
+#include "hasher.h"
+#include "md5_batch.h"
+#include "algorithms.h"
+#include "md5_salted.h"
+#include "md5_incremental.h"
+#include "generator.h"
+#include "traversal.h"
+#include "load_balancer.h"
+#include "shared_memory.h"
+#include "digest_table.h"
+#include "scheduler.h"
+#include "placement.h"
+#include "telemetry.h"
+#include "perf_counters.h"
+#include "checkpoint.h"
+#include "wordlist.h"
+#include "rules.h"
+#include "output_writer.h"
+
+namespace Cracking
+{
+    // One recovered key: which target it hashes to (the target table key, i.e. the
+    // digest itself for MD5 and NTLM and its first 16 bytes for SHA), where in the
+    // keyspace it was found and how long after the job started
+    struct Match
+    {
+        Hashing::Md5Digest digest;
+        Generators::Index index;
+        uint64_t elapsed_ns;
+        // Salt the key was found with, as an index into the job's salts
+        uint32_t salt = 0;
+    };
+
+    // Lives in shared memory; lets any worker tell every other one to stop
+    struct SharedState
+    {
+        std::atomic<bool> stop{false};
+        // Distinct targets recovered so far
+        std::atomic<size_t> found{0};
+    };
+
+    // Hash engine used by the workers
+    enum class Engine
+    {
+        Batch,       // Md5Batch over whole candidates
+        Incremental  // Md5Incremental patching only the last one or two message words
+    };
+
+    // How a candidate becomes the digest compared against the targets
+    enum class Construction
+    {
+        Plain,      // hash(pw)
+        SaltBefore, // md5(salt . pw)
+        SaltAfter,  // md5(pw . salt)
+        Iterated    // md5(md5(...md5(pw))) over the lowercase hex of each round
+    };
+
+    // How the keyspace is divided between the forks
+    enum class Schedule
+    {
+        Static,  // one equal slice per fork
+        Dynamic  // guided chunks claimed from a shared cursor
+    };
+
+    struct CrackConfig
+    {
+        size_t size = 5;
+        std::string charset = "abcdefghijklmnopqrstuvwxyz";
+        // Per-position pattern such as "?u?l?l?d?d"; replaces size and charset when set
+        std::string mask;
+        // Shortest length swept in the same job (prefixes of the mask); 0 sweeps one length
+        size_t min_size = 0;
+        int num_forks = 1;
+        // Hash function of the targets; targets hold their table keys (Hashing::keyFromHex)
+        Hashing::Algorithm algorithm = Hashing::Algorithm::Md5;
+        Construction construction = Construction::Plain;
+        // Rounds of MD5 for the iterated construction
+        size_t iterations = 2;
+        // Salts of the salted constructions; "hex:salt" lines of targets_file add theirs
+        std::vector<std::string> salts;
+        Engine engine = Engine::Batch;
+        // SIMD width of the hash kernels; the widest the CPU supports by default
+        Hashing::Isa isa = Hashing::Md5Batch::detectIsa();
+        Schedule schedule = Schedule::Dynamic;
+        // Smallest chunk handed out by the dynamic scheduler
+        size_t min_chunk = 1 << 14;
+        // Fork or thread workers, optionally pinned to cores
+        LoadBalancing::WorkerOptions workers;
+        // Keep each worker's candidate buffer on its own NUMA node
+        bool numa_local = false;
+        // Redraw a progress/ETA line on stderr while the job runs
+        bool progress = false;
+        // Count hardware events (cycles, instructions, misses) per worker
+        bool perf = false;
+        std::vector<Hashing::Md5Digest> targets;
+        // Optional file with one hex digest per line, merged with targets
+        std::string targets_file;
+        // Order of the candidates; ranges, shards and checkpoints are positions in it
+        Generators::Order order = Generators::Order::Linear;
+        // Key of the random order; a resumed job has to reuse it
+        uint64_t seed = 0;
+        // Index ranges to sweep, e.g. from a checkpoint; empty means the whole keyspace
+        std::vector<LoadBalancing::Range> ranges;
+        // Sweep only part shard of shards equal parts of the keyspace, so a space too
+        // large for one job (or one machine) can be split up
+        size_t shard = 0;
+        size_t shards = 1;
+        // When set, the unfinished ranges are saved here every checkpoint_interval
+        std::string checkpoint_file;
+        std::chrono::milliseconds checkpoint_interval{5000};
+        // Candidates come from this wordlist, mangled by every rule in rules_file
+        // (or kept as is without one), instead of from the keyspace
+        std::string wordlist;
+        std::string rules_file;
+        // Every hashed candidate is written here as an Output::Format record; such a
+        // job needs no targets and never ends early, even once all are found
+        std::string output_file;
+        Output::Format output_format = Output::Format::Text;
+        // Called every monitor_interval by the process running the job with the
+        // matches recorded since the last call (each is passed exactly once, the
+        // last call after the workers are done); returning false stops the job
+        // as if every target had been found
+        std::function<bool(const std::vector<Match>&)> monitor;
+        std::chrono::milliseconds monitor_interval{50};
+    };
+
+    struct CrackResult
+    {
+        std::vector<Match> matches;
+        // Candidates in the swept ranges (estimated for wordlists)
+        Generators::Index total = 0;
+        double elapsed_ms = 0;
+        // Final telemetry of every worker
+        std::vector<Monitoring::WorkerStats> workers;
+        // Hardware events of every worker with CrackConfig::perf, otherwise empty
+        std::vector<Profiling::Counts> counters;
+        // Why some events are missing from counters; empty when all were counted
+        std::string counters_unavailable;
+        // Size of CrackConfig::output_file
+        uint64_t output_bytes = 0;
+
+        // Candidates hashed by all workers together
+        uint64_t processed() const
+        {
+            uint64_t sum = 0;
+            for (const Monitoring::WorkerStats& worker : workers)
+                sum += worker.processed;
+            return sum;
+        }
+
+        // Hashes per second over the whole job, 0 when it ended instantly
+        double rate() const
+        {
+            return elapsed_ms > 0 ? processed() / (elapsed_ms / 1e3) : 0;
+        }
+
+        // Latency until the first key was recovered, or -1 when nothing was found
+        double firstHitMs() const
+        {
+            if (matches.empty())
+                return -1;
+
+            uint64_t first = matches.front().elapsed_ns;
+            for (const Match& match : matches)
+                first = std::min(first, match.elapsed_ns);
+            return first / 1e6;
+        }
+    };
+
+    // Sweeps a keyspace across LoadBalancer workers looking for keys whose MD5 is in
+    // the target set. Digests are compared raw; the job ends early as soon as
+    // every target has been found.
+    class Cracker
+    {
+    public:
+        explicit Cracker(CrackConfig config)
+            : config_(std::move(config)), keyspace_(keyspaceOf(config_)), targets_(loadTargets(config_))
+        {
+            if (targets_.size() == 0 && config_.output_file.empty())
+                throw std::invalid_argument("At least one target digest is required.");
+            if (!config_.output_file.empty() && (config_.engine == Engine::Incremental || config_.construction == Construction::SaltBefore ||
+                                                 config_.construction == Construction::SaltAfter))
+                throw std::invalid_argument("Output is only written by the batch engine without salts.");
+            if (config_.schedule == Schedule::Static && (!config_.ranges.empty() || !config_.checkpoint_file.empty()))
+                throw std::invalid_argument("Checkpoints and resumed ranges require the dynamic schedule.");
+            if (config_.engine == Engine::Incremental && (config_.algorithm != Hashing::Algorithm::Md5 || config_.construction != Construction::Plain))
+                throw std::invalid_argument("The incremental engine only supports plain MD5.");
+            if (config_.construction != Construction::Plain && config_.algorithm != Hashing::Algorithm::Md5)
+                throw std::invalid_argument("Salted and iterated modes only support MD5.");
+            if (config_.construction == Construction::Iterated && config_.iterations < 1)
+                throw std::invalid_argument("Iterated mode needs at least one round.");
+
+            if (config_.construction == Construction::SaltBefore || config_.construction == Construction::SaltAfter)
+            {
+                Hashing::SaltPosition position = config_.construction == Construction::SaltBefore ? Hashing::SaltPosition::Before
+                                                                                                  : Hashing::SaltPosition::After;
+                for (const std::string& salt : loadSalts(config_))
+                    salts_.emplace_back(salt, position);
+                if (salts_.empty())
+                    throw std::invalid_argument("Salted mode needs salts, given as hex:salt targets.");
+            }
+            if (!Hashing::Md5Batch::isSupported(config_.isa))
+                throw std::invalid_argument(std::string("Instruction set not supported by this CPU: ") + Hashing::Md5Batch::isaName(config_.isa));
+            if (config_.shards == 0 || config_.shard >= config_.shards)
+                throw std::invalid_argument("Shard must satisfy 0 <= shard < shards.");
+            if (config_.shards > 1 && !config_.ranges.empty())
+                throw std::invalid_argument("Resumed ranges cannot be sharded again.");
+
+            if (!config_.wordlist.empty())
+            {
+                if (config_.engine == Engine::Incremental)
+                    throw std::invalid_argument("The incremental engine only sweeps keyspaces, not wordlists.");
+                if (!config_.ranges.empty() || !config_.checkpoint_file.empty())
+                    throw std::invalid_argument("Checkpoints are not supported for wordlists.");
+
+                if (config_.order != Generators::Order::Linear)
+                    throw std::invalid_argument("Wordlists are only swept in order.");
+
+                wordlist_.emplace(config_.wordlist);
+                rules_ = config_.rules_file.empty() ? std::vector<Dictionary::Rule>{Dictionary::Rule::parse(":")}
+                                                    : Dictionary::Rule::load(config_.rules_file);
+            }
+            traversal_ = Generators::Traversal(config_.order, indexCount(), config_.seed);
+        }
+
+        // Number of distinct target digests
+        size_t targetCount() const
+        {
+            return targets_.size();
+        }
+
+        const Lookup::DigestTable& targets() const
+        {
+            return targets_;
+        }
+
+        CrackResult run()
+        {
+            std::vector<LoadBalancing::Range> ranges = config_.ranges;
+            if (ranges.empty())
+                ranges.push_back(LoadBalancing::slice({0, indexCount()}, config_.shard, config_.shards));
+            return run(std::move(ranges));
+        }
+
+        // Sweeps the given index ranges instead of the configured ones, e.g. leases
+        // handed out by a coordinator, reusing the loaded target set
+        CrackResult run(std::vector<LoadBalancing::Range> ranges)
+        {
+            if (config_.schedule == Schedule::Static && ranges.size() != 1)
+                throw std::invalid_argument("The static schedule sweeps exactly one range.");
+
+            CrackResult result;
+            for (const LoadBalancing::Range& range : ranges)
+                result.total += candidatesIn(range);
+
+            LoadBalancing::SharedMemory<SharedState> state;
+            LoadBalancing::SharedMemory<Match> log(std::max<size_t>(targets_.size(), 1));
+            // Set once the log entry of the same slot has been written
+            LoadBalancing::SharedMemory<std::atomic<bool>> recorded(log.size());
+            // Set by the first worker to hit a target, indexed by its table position
+            LoadBalancing::SharedMemory<std::atomic<bool>> claimed(targets_.positions());
+            Monitoring::Telemetry telemetry(config_.num_forks, result.total);
+            std::optional<Output::Writer> output;
+            if (!config_.output_file.empty())
+                output.emplace(config_.output_file, config_.num_forks);
+
+            LoadBalancing::WorkerOptions workers = config_.workers;
+            std::optional<Profiling::PerfCounters> counters;
+            if (config_.perf)
+            {
+                counters.emplace(config_.num_forks);
+                workers.counters = &*counters;
+            }
+
+            // Filled by each worker on first use; a forked worker fills its own copy
+            std::vector<std::optional<Placement::LocalBuffer<BlockScratch>>> scratch(config_.num_forks);
+
+            auto start_time = std::chrono::steady_clock::now();
+            auto context = [&](int worker_id)
+            {
+                return WorkerContext{start_time, *state, log.get(), recorded.get(), claimed.get(), telemetry.slot(worker_id),
+                                     output ? output->channel(worker_id) : Output::Channel{}, scratch[worker_id]};
+            };
+
+            if (config_.schedule == Schedule::Dynamic)
+            {
+                // A minimum chunk above the default cap raises the cap with it
+                LoadBalancing::DynamicScheduler scheduler(ranges, config_.num_forks, config_.min_chunk,
+                                                          std::max(config_.min_chunk, LoadBalancing::DynamicScheduler::DefaultMaxChunk));
+                scheduler_ = &scheduler;
+                {
+                    LoadBalancing::LoadBalancer lb(config_.num_forks, scheduler, [&](int worker_id, LoadBalancing::Range chunk)
+                                                   { sweep(chunk, context(worker_id)); }, workers);
+                    lb.start();
+                    if (output)
+                        output->start();
+
+                    // Destroyed after the workers are done, which writes the final checkpoint
+                    std::optional<Recovery::CheckpointWriter> writer;
+                    if (!config_.checkpoint_file.empty())
+                        writer.emplace(config_.checkpoint_file, config_.checkpoint_interval,
+                                       [&]() { return checkpoint(scheduler, telemetry); });
+                    watch(lb, telemetry, *state, log.get(), recorded.get());
+                }
+                scheduler_ = nullptr;
+            }
+            else
+            {
+                LoadBalancing::LoadBalancer lb(config_.num_forks, [&](int worker_id)
+                                               { sweep(LoadBalancing::slice(ranges.front(), worker_id, config_.num_forks), context(worker_id)); },
+                                               workers);
+                lb.start();
+                if (output)
+                    output->start();
+                watch(lb, telemetry, *state, log.get(), recorded.get());
+            }
+            if (output)
+            {
+                output->finish();
+                result.output_bytes = output->bytes();
+            }
+            auto end_time = std::chrono::steady_clock::now();
+
+            result.elapsed_ms = std::chrono::duration<double, std::milli>(end_time - start_time).count();
+            size_t found = std::min(state->found.load(), log.size());
+            result.matches.assign(log.get(), log.get() + found);
+            for (int i = 0; i < telemetry.workers(); ++i)
+                result.workers.push_back(telemetry.stats(i));
+            if (counters)
+            {
+                for (int i = 0; i < counters->workers(); ++i)
+                    result.counters.push_back(counters->worker(i));
+                result.counters_unavailable = counters->unavailableReason();
+            }
+            return result;
+        }
+
+        const Generators::Keyspace& keyspace() const
+        {
+            return keyspace_;
+        }
+
+        // Plaintext of a match
+        std::string keyOf(const Match& match) const
+        {
+            if (wordlist_)
+            {
+                std::string_view word = wordlist_->wordAt(static_cast<size_t>(match.index / rules_.size()));
+                return rules_[static_cast<size_t>(match.index % rules_.size())].apply(word);
+            }
+            return keyspace_.toString(match.index);
+        }
+
+        // Full hex digest of a match in the job's algorithm, followed by ":salt" in
+        // the salted modes
+        std::string digestOf(const Match& match) const
+        {
+            std::string key = keyOf(match);
+            if (!salts_.empty())
+            {
+                const Hashing::Md5Salted& salted = salts_[match.salt];
+                return Hashing::Md5::toHex(salted.digest(key)) + ":" + salted.salt();
+            }
+            if (config_.construction == Construction::Iterated)
+            {
+                Hashing::Md5Digest digest = Hashing::Md5::digest(key);
+                for (size_t round = 1; round < config_.iterations; ++round)
+                    digest = Hashing::Md5::digest(Hashing::Md5::toHex(digest));
+                return Hashing::Md5::toHex(digest);
+            }
+            return Hashing::hexDigest(config_.algorithm, key);
+        }
+
+    private:
+        CrackConfig config_;
+        Generators::Keyspace keyspace_;
+        Lookup::DigestTable targets_;
+        // Set while a dynamic run is in progress (and inherited by the forks)
+        LoadBalancing::DynamicScheduler* scheduler_ = nullptr;
+        // Wordlist mode: scheduled indices are byte offsets into the wordlist, and
+        // a match index is word offset * rule count + rule
+        std::optional<Dictionary::Wordlist> wordlist_;
+        std::vector<Dictionary::Rule> rules_;
+        // One per distinct salt of a salted job; every batch is hashed under each
+        std::vector<Hashing::Md5Salted> salts_;
+        // Maps scheduled positions to candidate indices
+        Generators::Traversal traversal_;
+
+        // Size of the index space the scheduler splits
+        Generators::Index indexCount() const
+        {
+            return wordlist_ ? wordlist_->size() : keyspace_.total();
+        }
+
+        // Candidates behind a range of scheduled indices; for a wordlist an
+        // estimate from its first megabyte, only used to show progress
+        Generators::Index candidatesIn(const LoadBalancing::Range& range) const
+        {
+            if (!wordlist_)
+                return range.size();
+            return Generators::Index{wordlist_->estimateWords(static_cast<size_t>(range.begin), static_cast<size_t>(range.end))} * rules_.size();
+        }
+
+        // Room for one candidate block of any swept length, so a worker allocates
+        // (and NUMA-binds) its block once rather than for every chunk
+        struct BlockScratch
+        {
+            alignas(64) unsigned char bytes[sizeof(Generators::CandidateBlock<1>)];
+        };
+
+        // Everything a worker writes to while sweeping
+        struct WorkerContext
+        {
+            std::chrono::steady_clock::time_point start_time;
+            SharedState& state;
+            Match* log;
+            std::atomic<bool>* recorded;
+            std::atomic<bool>* claimed;
+            Monitoring::WorkerSlot& slot;
+            // Ring of this worker when the job writes output, and its producer during a sweep
+            Output::Channel output;
+            std::optional<Placement::LocalBuffer<BlockScratch>>& scratch;
+            Output::Producer* producer = nullptr;
+            // Scheduled position minus candidate index over the current run, so
+            // progress is reported in positions
+            Generators::Index shift = 0;
+        };
+
+        // Unclaimed ranges plus the unswept tail of every worker's current chunk
+        Recovery::Checkpoint checkpoint(const LoadBalancing::DynamicScheduler& scheduler, const Monitoring::Telemetry& telemetry) const
+        {
+            Recovery::Checkpoint result;
+            result.size = keyspace_.maxSize();
+            result.min_size = keyspace_.minSize();
+            result.charset = config_.charset;
+            result.mask = config_.mask;
+            result.order = config_.order;
+            result.seed = config_.seed;
+            std::vector<LoadBalancing::Range> leases;
+            while (!scheduler.outstanding(result.ranges, leases))
+                std::this_thread::yield();
+
+            // A position outside its worker's lease is left over from an older chunk,
+            // in which case the whole lease is kept
+            for (size_t i = 0; i < leases.size(); ++i)
+            {
+                LoadBalancing::Range lease = leases[i];
+                Generators::Index position = telemetry.stats(static_cast<int>(i)).position;
+                if (position > lease.begin && position <= lease.end)
+                    lease.begin = position;
+                result.ranges.push_back(lease);
+            }
+
+            result.normalize();
+            return result;
+        }
+
+        // Waits for the workers, drawing the progress line meanwhile if enabled
+        void watch(LoadBalancing::LoadBalancer& lb, const Monitoring::Telemetry& telemetry, SharedState& state,
+                   const Match* log, const std::atomic<bool>* recorded) const
+        {
+            std::optional<Monitoring::ProgressView> view;
+            if (config_.progress)
+                view.emplace(telemetry);
+            // Joined before the view is drawn for the last time
+            std::optional<std::jthread> monitor;
+            if (config_.monitor)
+                monitor.emplace([&](std::stop_token token) { poll(token, state, log, recorded); });
+            lb.waitForChildren();
+        }
+
+        // Passes new log entries to config_.monitor until the workers are done
+        void poll(std::stop_token token, SharedState& state, const Match* log, const std::atomic<bool>* recorded) const
+        {
+            std::mutex mutex;
+            std::condition_variable_any wake;
+            std::unique_lock lock(mutex);
+            size_t seen = 0;
+            bool running = true;
+            while (running)
+            {
+                running = !wake.wait_for(lock, token, config_.monitor_interval, []() { return false; }) && !token.stop_requested();
+
+                std::vector<Match> fresh;
+                size_t found = std::min(state.found.load(), targets_.size());
+                while (seen < found && recorded[seen].load(std::memory_order_acquire))
+                    fresh.push_back(log[seen++]);
+                if (!config_.monitor(fresh) && !state.stop.exchange(true) && scheduler_ != nullptr)
+                    scheduler_->cancel();
+            }
+        }
+
+        static Generators::Keyspace keyspaceOf(const CrackConfig& config)
+        {
+            if (config.mask.empty())
+                return Generators::Keyspace(config.min_size == 0 ? config.size : config.min_size, config.size, config.charset);
+
+            Generators::Mask mask = Generators::Mask::parse(config.mask);
+            return Generators::Keyspace(mask, config.min_size == 0 ? mask.size() : config.min_size);
+        }
+
+        static Lookup::DigestTable loadTargets(CrackConfig& config)
+        {
+            if (config.targets_file.empty())
+                return Lookup::DigestTable(config.targets);
+
+            Lookup::DigestTable table = Lookup::DigestTable::fromFile(config.targets_file, config.algorithm);
+            if (config.targets.empty())
+                return table;
+
+            // Command line digests on top of a file: merge into one table
+            std::vector<Hashing::Md5Digest> all = std::move(config.targets);
+            table.forEach([&all](const Hashing::Md5Digest& digest) { all.push_back(digest); });
+            return Lookup::DigestTable(all);
+        }
+
+        // Distinct salts from the config and from "hex:salt" lines of the targets file
+        static std::vector<std::string> loadSalts(const CrackConfig& config)
+        {
+            std::set<std::string> salts(config.salts.begin(), config.salts.end());
+            if (!config.targets_file.empty())
+            {
+                std::ifstream file(config.targets_file);
+                if (!file.is_open())
+                    throw std::runtime_error("Unable to open file '" + config.targets_file + "'");
+
+                size_t hex = Hashing::hexLength(config.algorithm);
+                std::string line;
+                while (std::getline(file, line))
+                {
+                    if (!line.empty() && line.back() == '\r')
+                        line.pop_back();
+                    if (line.size() > hex && line[hex] == ':')
+                        salts.insert(line.substr(hex + 1));
+                }
+            }
+            return std::vector<std::string>(salts.begin(), salts.end());
+        }
+
+        // Longest run handed to one generator; only static slices of huge keyspaces are longer
+        static constexpr Generators::Index MaxGeneratorRun = Generators::Index{1} << 62;
+
+        void sweep(LoadBalancing::Range range, WorkerContext context) const
+        {
+            // Flushes this chunk's records into the ring when the sweep returns
+            std::optional<Output::Producer> producer;
+            if (context.output.ring != nullptr)
+                context.producer = &producer.emplace(context.output);
+
+            if (wordlist_)
+            {
+                sweepWords(range, context);
+                return;
+            }
+
+            // Scheduled positions are consecutive candidates only within a run of the traversal
+            traversal_.forEachRun(range.begin, range.end, [&](Generators::Index first, Generators::Index count, Generators::Index position)
+                                  {
+                context.shift = position - first;
+                sweepIndices(first, first + count, context); });
+        }
+
+        void sweepIndices(Generators::Index begin, Generators::Index end, WorkerContext& context) const
+        {
+            // A run may cross from one length into the next
+            keyspace_.forEachPiece(begin, end, [&](const Generators::Mask& mask, Generators::Index local,
+                                                   Generators::Index count, Generators::Index index)
+                                   {
+                while (count != 0 && !context.state.stop.load(std::memory_order_relaxed))
+                {
+                    Generators::Index run = std::min(count, MaxGeneratorRun);
+                    if (config_.engine == Engine::Incremental)
+                        sweepIncremental(mask, local, run, index, context);
+                    else
+                    {
+                        Generators::StringGenerator generator(mask, local, run);
+                        sweepBatch(generator, index, context);
+                    }
+
+                    local += run;
+                    index += run;
+                    count -= run;
+                } });
+        }
+
+        // Lengths up to this go through fixed-length candidate blocks
+        static constexpr size_t MaxBlockSweepLength = 16;
+
+        void sweepBatch(Generators::StringGenerator& generator, Generators::Index index, WorkerContext& context) const
+        {
+            if (config_.algorithm != Hashing::Algorithm::Md5 || config_.construction != Construction::Plain)
+            {
+                Hashing::withAlgorithm(config_.algorithm, [&](auto hasher)
+                                       { sweepMessages<typename decltype(hasher)::type>(generator, index, context); });
+                return;
+            }
+
+            bool done = Generators::withLength<MaxBlockSweepLength>(generator.size(), [&](auto length)
+                                                                    { sweepBlocks<length()>(generator, index, context); });
+            if (!done)
+                sweepMessages<Hashing::Md5Batch>(generator, index, context);
+        }
+
+        // Candidates are copied into lane buffers and packed by the hasher
+        template <typename Hasher>
+        void sweepMessages(Generators::StringGenerator& generator, Generators::Index index, WorkerContext& context) const
+        {
+            Hasher hasher(config_.isa);
+            size_t lanes = hasher.lanes();
+            size_t size = generator.size();
+            std::vector<char> candidates(size * lanes);
+            std::string_view views[Hashing::Md5Batch::MaxLanes];
+
+            while (generator.hasNext() && !context.state.stop.load(std::memory_order_relaxed))
+            {
+                size_t n = 0;
+                for (; n < lanes && generator.next(candidates.data() + n * size); ++n)
+                    views[n] = std::string_view(candidates.data() + n * size, size);
+
+                match(hasher, views, n, [index](size_t i) { return index + i; }, context);
+                index += n;
+                context.slot.advance(n, index + context.shift);
+            }
+        }
+
+        // Hashes n candidates under the job's construction and reports every target
+        // hit; candidate i sits at index indexOf(i). With salts the same candidates
+        // are hashed once per salt, so generator or rule output is never redone.
+        template <typename Hasher, typename IndexOf>
+        void match(const Hasher& hasher, const std::string_view* views, size_t n, IndexOf indexOf, WorkerContext& context) const
+        {
+            typename Hasher::Digest digests[Hashing::Md5Batch::MaxLanes];
+            auto check = [&](uint32_t salt)
+            {
+                for (size_t i = 0; i < n; ++i)
+                {
+                    if (context.producer != nullptr)
+                        emit<Hasher>(context, digests[i], views[i].data(), views[i].size(), indexOf(i));
+                    Hashing::Md5Digest key = Hasher::key(digests[i]);
+                    if (targets_.contains(key))
+                        report(context, {key, indexOf(i), elapsedNs(context.start_time), salt});
+                }
+            };
+
+            if constexpr (std::is_same_v<Hasher, Hashing::Md5Batch>)
+            {
+                if (!salts_.empty())
+                {
+                    for (size_t s = 0; s < salts_.size() && !context.state.stop.load(std::memory_order_relaxed); ++s)
+                    {
+                        salts_[s].hashBatch(hasher, views, n, digests);
+                        check(static_cast<uint32_t>(s));
+                    }
+                    return;
+                }
+            }
+
+            hasher.hashBatch(views, n, digests);
+            if constexpr (std::is_same_v<Hasher, Hashing::Md5Batch>)
+            {
+                if (config_.construction == Construction::Iterated)
+                    Hashing::rehashHex(hasher, digests, n, config_.iterations - 1);
+            }
+            check(0);
+        }
+
+        // The generator writes whole candidate blocks that the SIMD kernel reads as is
+        template <size_t Length>
+        void sweepBlocks(Generators::StringGenerator& generator, Generators::Index index, WorkerContext& context) const
+        {
+            Hashing::Md5Batch md5(config_.isa);
+            static_assert(sizeof(Generators::CandidateBlock<Length>) == sizeof(BlockScratch) &&
+                              alignof(Generators::CandidateBlock<Length>) <= alignof(BlockScratch),
+                          "Candidate blocks of every length have to fit the worker's scratch.");
+            if (!context.scratch)
+                context.scratch.emplace(config_.numa_local);
+            // Rewrites the padding for this length; the storage stays the worker's
+            Generators::CandidateBlock<Length>& block = *new ((*context.scratch)->bytes) Generators::CandidateBlock<Length>();
+            Hashing::Md5Digest digests[block.lanes()];
+
+            size_t n;
+            while (!context.state.stop.load(std::memory_order_relaxed) && (n = generator.nextBatch(block)) != 0)
+            {
+                md5.hashBlocks(&block.words[0][0], block.lanes(), n, digests);
+
+                for (size_t i = 0; i < n; ++i)
+                {
+                    if (targets_.contains(digests[i]))
+                        report(context, {digests[i], index + i, elapsedNs(context.start_time)});
+                }
+                if (context.producer != nullptr)
+                {
+                    char key[Length];
+                    for (size_t i = 0; i < n; ++i)
+                    {
+                        block.copyCandidate(i, key);
+                        emit<Hashing::Md5Batch>(context, digests[i], key, Length, index + i);
+                    }
+                }
+                index += n;
+                context.slot.advance(n, index + context.shift);
+            }
+        }
+
+        // Writes one output record for a hashed candidate
+        template <typename Hasher>
+        void emit(WorkerContext& context, const typename Hasher::Digest& digest, const char* key, size_t size,
+                  Generators::Index index) const
+        {
+            auto bytes = Hasher::toBytes(digest);
+            if (config_.output_format == Output::Format::Binary)
+                context.producer->binary(bytes.data(), bytes.size(), index);
+            else
+                context.producer->text(bytes.data(), bytes.size(), key, size);
+        }
+
+        // A varying word with fewer values than this (e.g. one character of a-z)
+        // gives short runs per prefix that leave lanes idle, so the word before it
+        // varies as well
+        static constexpr size_t MinVaryingValues = 1024;
+
+        // Sweeps count candidates of mask from local on. Within a run that shares
+        // the prefix only the varying words change, so their values are assembled
+        // from per-position character bytes and no candidate string is built: the
+        // last character comes from a table, the characters before it (and the
+        // terminator) only change when it wraps around.
+        void sweepIncremental(const Generators::Mask& mask, Generators::Index local, Generators::Index count,
+                              Generators::Index index, WorkerContext& context) const
+        {
+            size_t length = mask.size();
+            size_t last = length - 1;
+            Generators::Index values = 1;
+            for (size_t i = last / 4 * 4; i < length; ++i)
+                values *= mask.charset(i).size();
+            Hashing::Md5Incremental md5(length, config_.isa, length > 4 && values < MinVaryingValues ? 2 : 1);
+            if (targets_.size() <= Hashing::Md5Incremental::MaxReversedTargets)
+            {
+                std::vector<Hashing::Md5Digest> targets;
+                targets_.forEach([&targets](const Hashing::Md5Digest& digest) { targets.push_back(digest); });
+                md5.setTargets(targets);
+            }
+
+            size_t lanes = md5.lanes();
+            size_t prefix_size = md5.prefixSize();
+            // Varying word of every position past the prefix: 0 is the leading word of
+            // a two-word engine, the last one holds the final character and the terminator
+            auto wordOf = [prefix_size](size_t position) { return (position - prefix_size) / 4; };
+
+            // Byte of every character of a position, already shifted into place in its word
+            auto bytesOf = [&](size_t position)
+            {
+                std::array<uint32_t, 256> bytes{};
+                const std::string& charset = mask.charset(position);
+                for (size_t c = 0; c < charset.size(); ++c)
+                    bytes[c] = static_cast<uint32_t>(static_cast<uint8_t>(charset[c])) << ((position - prefix_size) % 4 * 8);
+                return bytes;
+            };
+            std::array<uint32_t, 256> finals = bytesOf(last);
+            std::array<std::array<uint32_t, 256>, 7> uppers;
+            uint32_t terminator = length % 4 != 0 ? 0x80u << (length % 4 * 8) : 0;
+
+            // Digits of the first candidate; the prefix is whatever lies before the varying words
+            Generators::Index position = local;
+            size_t final_size = mask.charset(last).size();
+            size_t final_digit = static_cast<size_t>(position % final_size);
+            position /= final_size;
+            std::array<size_t, 7> digits{};
+            for (size_t i = last; i-- > prefix_size;)
+            {
+                uppers[i - prefix_size] = bytesOf(i);
+                digits[i - prefix_size] = static_cast<size_t>(position % mask.charset(i).size());
+                position /= mask.charset(i).size();
+            }
+
+            std::string message(length, '\0');
+            Generators::Index per_prefix = 1;
+            for (size_t i = prefix_size; i < length; ++i)
+                per_prefix *= mask.charset(i).size();
+            Generators::Index prefix_count = (local % per_prefix + count + per_prefix - 1) / per_prefix;
+            std::optional<Generators::StringGenerator> prefixes;
+            if (prefix_size != 0)
+                prefixes.emplace(mask.prefix(prefix_size), position, prefix_count);
+
+            uint32_t leading[Hashing::Md5Batch::MaxLanes];
+            uint32_t words[Hashing::Md5Batch::MaxLanes];
+            Hashing::Md5Digest digests[Hashing::Md5Batch::MaxLanes];
+            size_t n = 0;
+
+            auto flush = [&]()
+            {
+                if (n == 0)
+                    return;
+                for (size_t i = n; i < lanes; ++i)
+                {
+                    leading[i] = leading[0];
+                    words[i] = words[0];
+                }
+
+                if (md5.reversing())
+                {
+                    uint32_t hits = md5.matchWords(leading, words) & ((1u << n) - 1);
+                    for (size_t i = 0; hits != 0; ++i, hits >>= 1)
+                    {
+                        if ((hits & 1) == 0)
+                            continue;
+                        std::string key = keyspace_.toString(index + i);
+                        Hashing::Md5Digest digest = Hashing::Md5::digest(key);
+                        if (targets_.contains(digest))
+                            report(context, {digest, index + i, elapsedNs(context.start_time)});
+                    }
+                }
+                else
+                {
+                    md5.hashWords(leading, words, digests);
+                    for (size_t i = 0; i < n; ++i)
+                    {
+                        if (targets_.contains(digests[i]))
+                            report(context, {digests[i], index + i, elapsedNs(context.start_time)});
+                    }
+                }
+                index += n;
+                context.slot.advance(n, index + context.shift);
+                n = 0;
+            };
+
+            bool next_prefix = true;
+            while (count != 0 && !context.state.stop.load(std::memory_order_relaxed))
+            {
+                if (next_prefix)
+                {
+                    // Lanes share one prefix, so the batch of the previous one goes out partly filled
+                    flush();
+                    if (prefixes)
+                        prefixes->next(message.data());
+                    md5.setPrefix(message.data());
+                }
+
+                uint32_t upper[2] = {0, 0};
+                upper[wordOf(last)] = terminator;
+                for (size_t i = prefix_size; i < last; ++i)
+                    upper[wordOf(i)] |= uppers[i - prefix_size][digits[i - prefix_size]];
+
+                size_t run = static_cast<size_t>(std::min<Generators::Index>(final_size - final_digit, count));
+                for (size_t d = final_digit; d < final_digit + run; ++d)
+                {
+                    leading[n] = upper[0];
+                    words[n++] = upper[wordOf(last)] | finals[d];
+                    if (n == lanes)
+                        flush();
+                }
+                count -= run;
+                final_digit = 0;
+
+                // Carry into the other characters of the varying words; past the first one the prefix moves on
+                next_prefix = true;
+                for (size_t i = last - prefix_size; i-- > 0;)
+                {
+                    if (++digits[i] < mask.charset(prefix_size + i).size())
+                    {
+                        next_prefix = false;
+                        break;
+                    }
+                    digits[i] = 0;
+                }
+            }
+            flush();
+        }
+
+        // Longest mangled word; the hasher falls back to scalar MD5 past one block
+        static constexpr size_t MaxWordCandidate = 256;
+
+        // Every rule is applied to each word starting in the byte range, writing
+        // straight into the lanes of the next batch
+        void sweepWords(LoadBalancing::Range range, WorkerContext& context) const
+        {
+            Hashing::withAlgorithm(config_.algorithm, [&](auto hasher)
+                                   { sweepWords<typename decltype(hasher)::type>(range, context); });
+        }
+
+        template <typename Hasher>
+        void sweepWords(LoadBalancing::Range range, WorkerContext& context) const
+        {
+            Hasher hasher(config_.isa);
+            size_t lanes = hasher.lanes();
+            std::vector<char> candidates(MaxWordCandidate * lanes);
+            std::string_view views[Hashing::Md5Batch::MaxLanes];
+            Generators::Index indices[Hashing::Md5Batch::MaxLanes];
+            size_t n = 0;
+            uint64_t attempted = 0;
+
+            // position is the offset of the word being mangled, which may not be finished yet
+            auto flush = [&](size_t position)
+            {
+                match(hasher, views, n, [&indices](size_t i) { return indices[i]; }, context);
+                context.slot.advance(attempted, position);
+                n = 0;
+                attempted = 0;
+            };
+
+            wordlist_->forEachWord(static_cast<size_t>(range.begin), static_cast<size_t>(range.end), [&](std::string_view word, size_t offset)
+                                   {
+                for (size_t r = 0; r < rules_.size(); ++r)
+                {
+                    ++attempted;
+                    char* out = candidates.data() + n * MaxWordCandidate;
+                    size_t length;
+                    if (!rules_[r].apply(word, out, MaxWordCandidate, length))
+                        continue;
+
+                    views[n] = std::string_view(out, length);
+                    indices[n] = Generators::Index{offset} * rules_.size() + r;
+                    if (++n == lanes)
+                        flush(offset);
+                }
+                return !context.state.stop.load(std::memory_order_relaxed); });
+
+            flush(static_cast<size_t>(range.end));
+        }
+
+        // Records the first match of a target and raises the stop flag once every
+        // target is accounted for. Wordlists and rules repeat candidates, so later
+        // hits of a target already claimed are dropped.
+        void report(WorkerContext& context, const Match& match) const
+        {
+            if (context.claimed[targets_.positionOf(match.digest)].exchange(true))
+                return;
+
+            context.slot.matched();
+            size_t slot = context.state.found.fetch_add(1);
+            if (slot < targets_.size())
+            {
+                context.log[slot] = match;
+                context.recorded[slot].store(true, std::memory_order_release);
+            }
+            if (slot + 1 >= targets_.size() && config_.output_file.empty())
+            {
+                context.state.stop.store(true);
+                if (scheduler_ != nullptr)
+                    scheduler_->cancel();
+            }
+        }
+
+        static uint64_t elapsedNs(std::chrono::steady_clock::time_point start_time)
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_time).count();
+        }
+    };
+}
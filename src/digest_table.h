@@ -0,0 +1,198 @@
+#pragma once
+
+#include <cstdint>
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <stdexcept>
+
+#include "hasher.h"
+#include "algorithms.h"
+#include "mapped_file.h"
+
+namespace Lookup
+{
+    // Set of target digests queried once per hashed candidate.
+    //
+    // A bitmap indexed by the third digest word rejects almost every candidate
+    // with a single cache-friendly load; the rare survivors probe an open-addressed
+    // table keyed on the first 64 bits of the digest (linear probing, load <= 0.5).
+    // Both live in mmap'd memory built before fork(), so the LoadBalancer children
+    // share one copy-on-write image instead of each holding their own.
+    class DigestTable
+    {
+    public:
+        explicit DigestTable(const std::vector<Hashing::Md5Digest>& digests)
+        {
+            allocate(digests.size());
+            for (const Hashing::Md5Digest& digest : digests)
+                insert(digest);
+        }
+
+        // Loads one hex digest of algorithm per line, keyed like Hashing::keyFromHex();
+        // blank lines and lines starting with '#' are skipped, anything from the first
+        // ':' on (a "hex:salt" salt) is ignored.
+        static DigestTable fromFile(const std::string& path, Hashing::Algorithm algorithm)
+        {
+            Storage::MappedFile file(path);
+
+            size_t count = 0;
+            forEachLine(file.view(), [&count](std::string_view) { ++count; });
+
+            DigestTable table;
+            table.allocate(count);
+            forEachLine(file.view(), [&table, algorithm](std::string_view line)
+                        { table.insert(Hashing::keyFromHex(algorithm, line.substr(0, line.find(':')))); });
+            return table;
+        }
+
+        bool contains(const Hashing::Md5Digest& digest) const
+        {
+            uint64_t bit = digest[2] & bitmap_mask_;
+            if (((bitmap_[bit >> 6] >> (bit & 63)) & 1) == 0)
+                return false;
+
+            for (size_t slot = key(digest) & slot_mask_;; slot = (slot + 1) & slot_mask_)
+            {
+                const Hashing::Md5Digest& entry = slots_[slot];
+                if (entry == digest)
+                    return !isEmpty(digest) || has_zero_;
+                if (isEmpty(entry))
+                    return false;
+            }
+        }
+
+        // Number of distinct digests
+        size_t size() const
+        {
+            return size_;
+        }
+
+        // Position of a digest the table contains, distinct per digest and below
+        // positions(), so per-target state can live in an array beside the table
+        size_t positionOf(const Hashing::Md5Digest& digest) const
+        {
+            if (isEmpty(digest))
+                return slot_mask_ + 1;
+
+            size_t slot = key(digest) & slot_mask_;
+            while (slots_[slot] != digest && !isEmpty(slots_[slot]))
+                slot = (slot + 1) & slot_mask_;
+            return slot;
+        }
+
+        // One past the largest positionOf, the slots plus the all-zero digest
+        size_t positions() const
+        {
+            return slot_mask_ + 2;
+        }
+
+        // Bytes of mapped memory used by the bitmap and the slots
+        size_t memoryUsage() const
+        {
+            return bitmap_region_.size() + slot_region_.size();
+        }
+
+        template <typename Visitor>
+        void forEach(Visitor visit) const
+        {
+            if (has_zero_)
+                visit(Hashing::Md5Digest{});
+            for (size_t slot = 0; slot <= slot_mask_; ++slot)
+            {
+                if (!isEmpty(slots_[slot]))
+                    visit(slots_[slot]);
+            }
+        }
+
+    private:
+        Storage::MappedRegion bitmap_region_;
+        Storage::MappedRegion slot_region_;
+        const uint64_t* bitmap_ = nullptr;
+        const Hashing::Md5Digest* slots_ = nullptr;
+        uint64_t bitmap_mask_ = 0;
+        size_t slot_mask_ = 0;
+        size_t size_ = 0;
+        bool has_zero_ = false;
+
+        DigestTable() = default;
+
+        void allocate(size_t expected)
+        {
+            // 16 bitmap bits per target keeps the false-positive rate around 1/16
+            size_t bits = nextPowerOfTwo(std::max<size_t>(expected * 16, 512));
+            size_t slots = nextPowerOfTwo(std::max<size_t>(expected * 2, 16));
+
+            bitmap_region_ = Storage::MappedRegion(bits / 8);
+            slot_region_ = Storage::MappedRegion(slots * sizeof(Hashing::Md5Digest));
+            bitmap_ = bitmap_region_.as<uint64_t>();
+            slots_ = slot_region_.as<Hashing::Md5Digest>();
+            bitmap_mask_ = bits - 1;
+            slot_mask_ = slots - 1;
+        }
+
+        void insert(const Hashing::Md5Digest& digest)
+        {
+            uint64_t bit = digest[2] & bitmap_mask_;
+            bitmap_region_.as<uint64_t>()[bit >> 6] |= uint64_t{1} << (bit & 63);
+
+            // The all-zero digest doubles as the empty marker, so it is only flagged
+            if (isEmpty(digest))
+            {
+                size_ += has_zero_ ? 0 : 1;
+                has_zero_ = true;
+                return;
+            }
+
+            Hashing::Md5Digest* slots = slot_region_.as<Hashing::Md5Digest>();
+            for (size_t slot = key(digest) & slot_mask_;; slot = (slot + 1) & slot_mask_)
+            {
+                if (slots[slot] == digest)
+                    return;
+                if (isEmpty(slots[slot]))
+                {
+                    slots[slot] = digest;
+                    ++size_;
+                    return;
+                }
+            }
+        }
+
+        // MD5 output is uniformly distributed, so its leading 64 bits are a good hash
+        static uint64_t key(const Hashing::Md5Digest& digest)
+        {
+            return (static_cast<uint64_t>(digest[1]) << 32) | digest[0];
+        }
+
+        static bool isEmpty(const Hashing::Md5Digest& digest)
+        {
+            return (digest[0] | digest[1] | digest[2] | digest[3]) == 0;
+        }
+
+        static size_t nextPowerOfTwo(size_t value)
+        {
+            size_t result = 1;
+            while (result < value)
+                result <<= 1;
+            return result;
+        }
+
+        template <typename Callback>
+        static void forEachLine(std::string_view text, Callback callback)
+        {
+            while (!text.empty())
+            {
+                size_t end = text.find('\n');
+                std::string_view line = text.substr(0, end);
+                text = (end == std::string_view::npos) ? std::string_view() : text.substr(end + 1);
+
+                if (!line.empty() && line.back() == '\r')
+                    line.remove_suffix(1);
+                if (line.empty() || line.front() == '#')
+                    continue;
+                callback(line);
+            }
+        }
+    };
+}
@@ -6,9 +6,86 @@
 #include <algorithm>
 #include <cmath>
 #include <limits>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <type_traits>
+
+#include "index.h"
+#include "mask.h"
+#include "keyspace.h"
 
 namespace Generators
 {
+    // Longest candidate that still fits one MD5/MD4 block with its padding
+    constexpr size_t MaxBlockLength = 55;
+
+    // Fixed-length candidates laid out as padded MD5/MD4 message blocks in
+    // structure-of-arrays form: word j of lane l is words[j][l], so a SIMD hasher
+    // can load each message word for all lanes with one vector load. The
+    // terminator and bit-length words never change and are written once here.
+    template <size_t Length, size_t Lanes = 16>
+    struct CandidateBlock
+    {
+        static_assert(Length >= 1 && Length <= MaxBlockLength, "Candidate must fit into a single block.");
+
+        // Words holding at least one character
+        static constexpr size_t CharWords = (Length + 3) / 4;
+        // Word and bits of the 0x80 terminator
+        static constexpr size_t PadWord = Length / 4;
+        static constexpr uint32_t PadBits = 0x80u << ((Length % 4) * 8);
+
+        alignas(64) uint32_t words[16][Lanes];
+
+        CandidateBlock()
+        {
+            std::memset(words, 0, sizeof(words));
+            for (size_t lane = 0; lane < Lanes; ++lane)
+            {
+                words[PadWord][lane] = PadBits;
+                words[14][lane] = static_cast<uint32_t>(Length * 8);
+            }
+        }
+
+        static constexpr size_t lanes()
+        {
+            return Lanes;
+        }
+
+        // Characters of one lane, mainly for reporting
+        std::string candidate(size_t lane) const
+        {
+            std::string result(Length, '\0');
+            copyCandidate(lane, result.data());
+            return result;
+        }
+
+        // Writes the Length characters of one lane to out
+        void copyCandidate(size_t lane, char* out) const
+        {
+            for (size_t i = 0; i < Length; ++i)
+                out[i] = static_cast<char>(words[i / 4][lane] >> ((i % 4) * 8));
+        }
+    };
+
+    // Calls f(std::integral_constant<size_t, size>{}) for 1 <= size <= MaxLength,
+    // so fixed-length code can be picked at runtime. Returns false otherwise.
+    template <size_t MaxLength, typename F>
+    bool withLength(size_t size, F&& f)
+    {
+        return [&]<size_t... L>(std::index_sequence<L...>)
+        {
+            return ((size == L + 1 && (f(std::integral_constant<size_t, L + 1>{}), true)) || ...);
+        }(std::make_index_sequence<MaxLength>{});
+    }
+
+    // Enumerates fixed-size strings over a charset (or a Mask with one charset
+    // per position) in lexicographic order.
+    //
+    // The current string is kept as odometer digits (indices into each position's
+    // charset) plus a count of strings still to emit, so advancing is an amortised
+    // O(1) digit bump with no charset search and no string comparison against the end.
     class StringGenerator
     {
     public:
@@ -16,26 +93,13 @@ namespace Generators
                         const std::string& charset = "abcdefghijklmnopqrstuvwxyz",
                         const std::string& start = "",
                         const std::string& end = "")
-            : size_(size), charset_(charset), exhausted_(false)
-        {
-            if (size_ == 0)
-                throw std::invalid_argument("String size must be at least 1.");
-            if (charset_.empty())
-                throw std::invalid_argument("Character set must contain at least one character.");
-            
-            // check sorted and has unique characters
-            std::string sorted_charset = charset_;
-            std::sort(sorted_charset.begin(), sorted_charset.end());
-            auto last = std::unique(sorted_charset.begin(), sorted_charset.end());
-            sorted_charset.erase(last, sorted_charset.end());
-            charset_ = sorted_charset;
-            
+            : size_(size), mask_(size, charset)
+        {
             // If start and end are not provided, generate from first to last string
             if (start.empty() && end.empty())
             {
-                current_.assign(size_, charset_[0]);
-                end_ = generateLastString();
-                start_provided_ = false;
+                start_index_ = 0;
+                count_ = countOf(mask_.total());
             }
             else
             {
@@ -45,196 +109,213 @@ namespace Generators
                 if (start.size() != size_ || end.size() != size_)
                     throw std::invalid_argument("Start and end strings must be of the specified size.");
                 
-                if (!isValidString(start))
+                if (!mask_.contains(start))
                     throw std::invalid_argument("Start string contains characters not in the character set.");
-                if (!isValidString(end))
+                if (!mask_.contains(end))
                     throw std::invalid_argument("End string contains characters not in the character set.");
                 
                 if (start > end)
                     throw std::invalid_argument("Start string must be lexicographically less than or equal to end string.");
                 
-                current_ = start;
-                end_ = end;
-                start_ = start;
-                start_provided_ = true;
+                start_index_ = mask_.toIndex(start);
+                count_ = countOf(mask_.toIndex(end) - start_index_ + 1);
             }
+
+            reset();
+        }
+
+        // Generates count strings starting at position start_index of the series
+        StringGenerator(size_t size, const std::string& charset, Index start_index, Index count)
+            : StringGenerator(Mask(size, charset), start_index, count)
+        {
+        }
+
+        // Generates count strings of the mask's keyspace starting at position start_index
+        StringGenerator(const Mask& mask, Index start_index, Index count)
+            : size_(mask.size()), mask_(mask), start_index_(start_index)
+        {
+            Index total = mask_.total();
+            if (start_index_ > total || count > total - start_index_)
+                throw std::out_of_range("Range is out of the valid range for the given size and charset.");
+
+            count_ = countOf(count);
+            reset();
         }
 
         bool hasNext() const
         {
-            return !exhausted_;
+            return remaining_ != 0;
         }
 
         std::string next()
         {
-            if (exhausted_)
+            if (remaining_ == 0)
                 throw std::out_of_range("No more strings to generate.");
 
             std::string result = current_;
+            advance();
+            return result;
+        }
 
-            // Increment the current string to the next combination
-            increment();
+        // Writes the next string (size() bytes, not terminated) into out.
+        // Returns false once the range is exhausted.
+        bool next(char* out)
+        {
+            if (remaining_ == 0)
+                return false;
 
-            return result;
+            std::memcpy(out, current_.data(), size_);
+            advance();
+            return true;
         }
 
         // Resets the generator to the initial state
         void reset()
         {
-            if (start_provided_)
-            {
-                current_ = start_;
-                exhausted_ = false;
-            }
-            else
+            remaining_ = count_;
+            digits_.assign(size_, 0);
+            current_.assign(size_, '\0');
+
+            // Decompose the start index into mixed-radix digits, last position fastest
+            Index position = start_index_;
+            for (size_t i = size_; i-- > 0;)
             {
-                current_.assign(size_, charset_[0]);
-                end_ = generateLastString();
-                exhausted_ = false;
+                const std::string& charset = mask_.charset(i);
+                digits_[i] = static_cast<uint32_t>(position % charset.size());
+                current_[i] = charset[digits_[i]];
+                position /= charset.size();
             }
         }
 
-        // Converts a position in the series to its value in the series ("aaa" -> 0, "aab" -> 1 etc.)
-        static std::string numberToString(size_t size, size_t position, const std::string& charset = "abcdefghijklmnopqrstuvwxyz")
-        {
-            if (size == 0)
-                throw std::invalid_argument("String size must be at least 1.");
-            if (charset.empty())
-                throw std::invalid_argument("Character set must contain at least one character.");
-
-            // Ensures charset is sorted and has unique characters
-            std::string sorted_charset = charset;
-            std::sort(sorted_charset.begin(), sorted_charset.end());
-            auto last = std::unique(sorted_charset.begin(), sorted_charset.end());
-            sorted_charset.erase(last, sorted_charset.end());
-            std::string unique_charset = sorted_charset;
-
-            size_t base = unique_charset.size();
-
-            // Calculates total number of combinations: base^size
-            // To prevent overflow, uses iterative multiplication
-            size_t total = 1;
-            for (size_t i = 0; i < size; ++i)
-            {
-                if (base == 0)
-                    throw std::invalid_argument("Character set size cannot be zero.");
+        size_t size() const
+        {
+            return size_;
+        }
 
-                // Check for potential overflow
-                if (total > (std::numeric_limits<size_t>::max() / base))
-                    throw std::overflow_error("Total number of combinations exceeds size_t limits.");
+        // Sorted, de-duplicated charset actually used for enumeration (of the
+        // first position when the generator runs a mask)
+        const std::string& charset() const
+        {
+            return mask_.charset(0);
+        }
 
-                total *= base;
-            }
+        const Mask& mask() const
+        {
+            return mask_;
+        }
 
-            if (position >= total)
-                throw std::out_of_range("Position is out of the valid range for the given size and charset.");
+        // Position in the series of the string the next call to next() returns
+        Index position() const
+        {
+            return start_index_ + (count_ - remaining_);
+        }
 
-            // Initialize string with all first characters
-            std::string result(size, unique_charset[0]);
+        // Strings left to generate
+        size_t remaining() const
+        {
+            return remaining_;
+        }
 
-            size_t current_position = position;
+        // Fills up to n lanes of block with the next strings, which must be Length
+        // characters long. Returns how many lanes were written; the rest keep stale data.
+        template <size_t Length, size_t Lanes>
+        size_t nextBatch(CandidateBlock<Length, Lanes>& block, size_t n = Lanes)
+        {
+            if (size_ != Length)
+                throw std::invalid_argument("Candidate block length does not match the generator size.");
 
-            // Fill the string from the end to the beginning
-            for (int i = static_cast<int>(size) - 1; i >= 0; --i)
+            n = std::min({n, Lanes, remaining_});
+            for (size_t lane = 0; lane < n; ++lane)
             {
-                size_t index = current_position % base;
-                result[i] = unique_charset[index];
-                current_position /= base;
+                for (size_t w = 0; w < CandidateBlock<Length, Lanes>::CharWords; ++w)
+                {
+                    uint32_t word = 0;
+                    size_t chars = std::min<size_t>(4, Length - w * 4);
+                    std::memcpy(&word, current_.data() + w * 4, chars);
+                    if (w == CandidateBlock<Length, Lanes>::PadWord)
+                        word |= CandidateBlock<Length, Lanes>::PadBits;
+                    block.words[w][lane] = word;
+                }
+                advance();
             }
-
-            return result;
+            return n;
         }
 
-        // Calculates the total number of possible combinations based on string size and charset.
-        static size_t totalCombinations(size_t size, const std::string& charset = "abcdefghijklmnopqrstuvwxyz")
+        // Converts a value in the series to its position ("aaa" -> 0, "aab" -> 1 etc.)
+        static Index stringToNumber(const std::string& str, const std::string& charset = "abcdefghijklmnopqrstuvwxyz")
         {
-            if (size == 0)
-                throw std::invalid_argument("String size must be at least 1.");
-            if (charset.empty())
-                throw std::invalid_argument("Character set must contain at least one character.");
-
-            // Ensure charset is sorted and has unique characters
-            std::string sorted_charset = charset;
-            std::sort(sorted_charset.begin(), sorted_charset.end());
-            auto last = std::unique(sorted_charset.begin(), sorted_charset.end());
-            sorted_charset.erase(last, sorted_charset.end());
-            std::string unique_charset = sorted_charset;
+            return Mask(str.size(), charset).toIndex(str);
+        }
 
-            size_t base = unique_charset.size();
+        // Converts a position in the series to its value in the series ("aaa" -> 0, "aab" -> 1 etc.)
+        static std::string numberToString(size_t size, Index position, const std::string& charset = "abcdefghijklmnopqrstuvwxyz")
+        {
+            return Mask(size, charset).toString(position);
+        }
 
-            // Calculate total number of combinations: base^size
-            size_t total = 1;
-            for (size_t i = 0; i < size; ++i)
-            {
-                if (base == 0)
-                    throw std::invalid_argument("Character set size cannot be zero.");
+        static std::string numberToString(const Mask& mask, Index position)
+        {
+            return mask.toString(position);
+        }
 
-                // Check for potential overflow
-                if (total > (std::numeric_limits<size_t>::max() / base))
-                    throw std::overflow_error("Total number of combinations exceeds size_t limits.");
+        // Calculates the total number of possible combinations based on string size and charset.
+        static Index totalCombinations(size_t size, const std::string& charset = "abcdefghijklmnopqrstuvwxyz")
+        {
+            return Mask(size, charset).total();
+        }
 
-                total *= base;
-            }
+        // Candidates of every length from min_size to max_size together
+        static Index totalCombinations(size_t min_size, size_t max_size, const std::string& charset)
+        {
+            return Keyspace(min_size, max_size, charset).total();
+        }
 
-            return total;
+        // Global position over lengths min_size..max_size, shortest first ("z" -> 25, "aa" -> 26 etc.)
+        static std::string numberToString(size_t min_size, size_t max_size, Index position, const std::string& charset)
+        {
+            return Keyspace(min_size, max_size, charset).toString(position);
         }
 
+        // Product of the per-position charset sizes
+        static Index totalCombinations(const Mask& mask)
+        {
+            return mask.total();
+        }
 
     private:
-        size_t size_;                 
-        std::string charset_;         
-        std::string current_;         
-        std::string end_;             
-        bool exhausted_;              
-        bool start_provided_ = false; 
-        std::string start_;           
-
-        // Helper function to check if a string contains only characters from the charset
-        bool isValidString(const std::string& str) const
-        {
-            for (char c : str)
-            {
-                if (charset_.find(c) == std::string::npos)
-                    return false;
-            }
-            return true;
+        size_t size_;
+        Mask mask_;
+        std::string current_;
+        std::vector<uint32_t> digits_;
+        Index start_index_ = 0;
+        size_t count_ = 0;
+        size_t remaining_ = 0;
+
+        // One generator walks at most size_t strings; larger ranges are split by the caller
+        static size_t countOf(Index count)
+        {
+            if (count > std::numeric_limits<size_t>::max())
+                throw std::overflow_error("Range is too large for one generator; split it into smaller ranges.");
+            return static_cast<size_t>(count);
         }
 
-        // Helper function to generate the last possible string based on the charset and size
-        std::string generateLastString() const
+        void advance()
         {
-            return std::string(size_, charset_.back());
+            if (--remaining_ != 0)
+                increment();
         }
 
-        // Helper function to increment the current string lexicographically
+        // Bumps the odometer by one; only called while strings remain, so it never wraps
         void increment()
         {
-            for (int i = static_cast<int>(size_) - 1; i >= 0; --i)
+            size_t i = size_ - 1;
+            while (digits_[i] + 1 == mask_.charset(i).size())
             {
-                size_t pos = charset_.find(current_[i]);
-                if (pos == std::string::npos)
-                {
-                    throw std::logic_error("Current character not found in charset.");
-                }
-
-                if (pos < charset_.size() - 1)
-                {
-                    current_[i] = charset_[pos + 1];
-                    // Reset all characters to the right to the first character in the charset
-                    for (size_t j = i + 1; j < size_; ++j)
-                    {
-                        current_[j] = charset_[0];
-                    }
-                    // Check if we've exceeded the end string
-                    if (start_provided_ && current_ > end_)
-                    {
-                        exhausted_ = true;
-                    }
-                    return;
-                }
-                current_[i] = charset_[0];
+                digits_[i] = 0;
+                current_[i] = mask_.charset(i)[0];
+                --i;
             }
-            exhausted_ = true;
+            current_[i] = mask_.charset(i)[++digits_[i]];
         }
     };
 }
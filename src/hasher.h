@@ -3,8 +3,9 @@
 #include <array>
 #include <cstdint>
 #include <cstring>
-#include <iomanip>
-#include <sstream>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
 
 namespace Hashing
 {
@@ -15,132 +16,256 @@ namespace Hashing
         virtual std::string hash(const std::string& msg) const = 0;
     };
 
+    // Raw MD5 digest as the four state words A, B, C, D. The canonical 16-byte
+    // digest is the little-endian serialisation of these words.
+    typedef std::array<uint32_t, 4> Md5Digest;
+
     class Md5 : public IHasher
     {
     public:
+        // Longest message whose padding and length still fit into a single block
+        static constexpr size_t MaxSingleBlockSize = 55;
+
+        static constexpr std::array<uint32_t, 4> IV = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476};
+
+        static constexpr std::array<int, 64> S = {
+            7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+            5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20,
+            4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+            6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21
+        };
+
+        static constexpr std::array<uint32_t, 64> K = {
+            0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee,
+            0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+            0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be,
+            0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+            0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa,
+            0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+            0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed,
+            0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+            0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c,
+            0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+            0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05,
+            0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+            0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039,
+            0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+            0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
+            0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+        };
+
         std::string hash(const std::string& msg) const override
         {
-            uint32_t a0 = 0x67452301; // A
-            uint32_t b0 = 0xefcdab89; // B
-            uint32_t c0 = 0x98badcfe; // C
-            uint32_t d0 = 0x10325476; // D
-
-            static const std::array<int, 64> S = {
-                7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
-                5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20,
-                4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
-                6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21
-            };
-
-            static const std::array<uint32_t, 64> K = {
-                0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee,
-                0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
-                0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be,
-                0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
-                0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa,
-                0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
-                0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed,
-                0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
-                0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c,
-                0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
-                0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05,
-                0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
-                0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039,
-                0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
-                0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
-                0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
-            };
-
-            // Append "1" bit to message
-            std::string processed = msg;
-            processed += static_cast<char>(0x80);
-
-            // Padding with zeros
-            size_t original_length = processed.size() * 8; // in bits
-            while ((processed.size() * 8) % 512 != 448)
-                processed += static_cast<char>(0x00);
+            return toHex(digest(msg));
+        }
+
+        // Computes the raw digest of msg without touching the heap. Whole 64-byte
+        // chunks are read in place; the tail, terminator and length are padded in
+        // one or two stack blocks.
+        static Md5Digest digest(std::string_view msg)
+        {
+            if (msg.size() <= MaxSingleBlockSize)
+                return digestShort(msg.data(), msg.size());
+            return digest(msg, IV, 0);
+        }
+
+        // Continues from state, which has already absorbed absorbed_bytes (a multiple
+        // of 64) of the message, e.g. the whole blocks of a salt prefix
+        static Md5Digest digest(std::string_view msg, const Md5Digest& initial, uint64_t absorbed_bytes)
+        {
+            Md5Digest state = initial;
+            uint32_t M[16];
+
+            size_t offset = 0;
+            for (; offset + 64 <= msg.size(); offset += 64)
+            {
+                loadWords(msg.data() + offset, M);
+                compress(state.data(), M);
+            }
+
+            uint8_t tail[128] = {};
+            size_t rest = msg.size() - offset;
+            std::memcpy(tail, msg.data() + offset, rest);
+            tail[rest] = 0x80;
 
             // Append original length in bits mod 2^64 to message
-            uint64_t original_length_bits = original_length;
+            size_t blocks = (rest <= MaxSingleBlockSize) ? 1 : 2;
+            uint64_t original_length_bits = (absorbed_bytes + msg.size()) * 8;
             for (int i = 0; i < 8; ++i)
+                tail[blocks * 64 - 8 + i] = static_cast<uint8_t>(original_length_bits >> (i * 8));
+
+            for (size_t block = 0; block < blocks; ++block)
             {
-                processed += static_cast<char>((original_length_bits >> (i * 8)) & 0xFF);
+                loadWords(reinterpret_cast<const char*>(tail) + block * 64, M);
+                compress(state.data(), M);
             }
 
-            // Process the message in successive 512-bit chunks:
-            for (size_t chunk = 0; chunk < processed.size(); chunk += 64)
+            return state;
+        }
+
+        // Single-block fast path for messages of at most MaxSingleBlockSize bytes
+        static Md5Digest digestShort(const char* msg, size_t len)
+        {
+            uint8_t block[64] = {};
+            std::memcpy(block, msg, len);
+            block[len] = 0x80;
+
+            uint32_t M[16];
+            loadWords(reinterpret_cast<const char*>(block), M);
+            M[14] = static_cast<uint32_t>(len * 8);
+
+            Md5Digest state = IV;
+            compress(state.data(), M);
+            return state;
+        }
+
+        // Canonical 16-byte form of a raw digest
+        static std::array<uint8_t, 16> toBytes(const Md5Digest& digest)
+        {
+            std::array<uint8_t, 16> bytes;
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            std::memcpy(bytes.data(), digest.data(), 16);
+#else
+            for (size_t i = 0; i < 16; ++i)
+                bytes[i] = static_cast<uint8_t>(digest[i / 4] >> ((i % 4) * 8));
+#endif
+            return bytes;
+        }
+
+        // Writes the 32 character lowercase hex form of digest into out (not terminated)
+        static void toHex(const Md5Digest& digest, char* out)
+        {
+            static constexpr char hex[] = "0123456789abcdef";
+            std::array<uint8_t, 16> bytes = toBytes(digest);
+            for (size_t i = 0; i < 16; ++i)
+            {
+                out[i * 2] = hex[bytes[i] >> 4];
+                out[i * 2 + 1] = hex[bytes[i] & 0x0F];
+            }
+        }
+
+        // Formats a raw digest as the usual 32 character lowercase hex string
+        static std::string toHex(const Md5Digest& digest)
+        {
+            std::string result(32, '0');
+            toHex(digest, result.data());
+            return result;
+        }
+
+        // Parses a 32 character hex digest (either case) back into its raw form
+        static Md5Digest fromHex(std::string_view hex)
+        {
+            if (hex.size() != 32)
+                throw std::invalid_argument("MD5 digest must be 32 hex characters: '" + std::string(hex) + "'.");
+
+            Md5Digest digest = {};
+            for (size_t i = 0; i < 32; ++i)
             {
-                // Break chunk into 16 32-bit little-endian words M[j], 0 ≤ j ≤ 15
-                uint32_t M[16];
-                for (int i = 0; i < 16; ++i)
-                {
-                    M[i] = static_cast<uint8_t>(processed[chunk + i * 4]) |
-                           (static_cast<uint8_t>(processed[chunk + i * 4 + 1]) << 8) |
-                           (static_cast<uint8_t>(processed[chunk + i * 4 + 2]) << 16) |
-                           (static_cast<uint8_t>(processed[chunk + i * 4 + 3]) << 24);
-                }
-
-                // Initialize hash value for this chunk:
-                uint32_t A = a0;
-                uint32_t B = b0;
-                uint32_t C = c0;
-                uint32_t D = d0;
-
-                // Main loop:
-                for (int i = 0; i < 64; ++i)
-                {
-                    uint32_t F, g;
-
-                    if (i < 16)
-                    {
-                        F = (B & C) | ((~B) & D);
-                        g = i;
-                    }
-                    else if (i < 32)
-                    {
-                        F = (D & B) | ((~D) & C);
-                        g = (5 * i + 1) % 16;
-                    }
-                    else if (i < 48)
-                    {
-                        F = B ^ C ^ D;
-                        g = (3 * i + 5) % 16;
-                    }
-                    else
-                    {
-                        F = C ^ (B | (~D));
-                        g = (7 * i) % 16;
-                    }
-
-                    uint32_t temp = D;
-                    D = C;
-                    C = B;
-                    B = B + left_rotate((A + F + K[i] + M[g]), S[i]);
-                    A = temp;
-                }
-
-                // Add this chunk's hash to result:
-                a0 += A;
-                b0 += B;
-                c0 += C;
-                d0 += D;
+                char c = hex[i];
+                uint32_t nibble;
+                if (c >= '0' && c <= '9')
+                    nibble = c - '0';
+                else if (c >= 'a' && c <= 'f')
+                    nibble = c - 'a' + 10;
+                else if (c >= 'A' && c <= 'F')
+                    nibble = c - 'A' + 10;
+                else
+                    throw std::invalid_argument("MD5 digest contains a non-hex character: '" + std::string(hex) + "'.");
+
+                // Byte i / 2 of the digest; the high nibble comes first
+                size_t byte = i / 2;
+                digest[byte / 4] |= nibble << ((byte % 4) * 8 + ((i % 2) ? 0 : 4));
             }
+            return digest;
+        }
+
+        // Runs the 64 MD5 steps over one 512-bit block and adds the result to state.
+        // V is either uint32_t or a GCC vector of uint32_t, in which case every lane
+        // carries an independent message (see md5_batch.h).
+        template <typename V>
+        [[gnu::always_inline]] static inline void compress(V* state, const V* M)
+        {
+            V A = state[0];
+            V B = state[1];
+            V C = state[2];
+            V D = state[3];
+
+            rounds(std::make_index_sequence<16>{}, A, B, C, D, M);
 
-            // final hash value
-            std::ostringstream oss;
-            oss << std::hex << std::setfill('0');
-            oss << std::setw(8) << a0;
-            oss << std::setw(8) << b0;
-            oss << std::setw(8) << c0;
-            oss << std::setw(8) << d0;
-            return oss.str();
+            // Add this chunk's hash to result:
+            state[0] += A;
+            state[1] += B;
+            state[2] += C;
+            state[3] += D;
         }
 
     private:
-        // Left-rotate a 32-bit integer x by n bits
-        static uint32_t left_rotate(uint32_t x, int n)
+        // Breaks a 64-byte chunk into 16 32-bit little-endian words M[j], 0 ≤ j ≤ 15
+        static void loadWords(const char* chunk, uint32_t* M)
+        {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            std::memcpy(M, chunk, 64);
+#else
+            for (int i = 0; i < 16; ++i)
+            {
+                M[i] = static_cast<uint8_t>(chunk[i * 4]) |
+                       (static_cast<uint8_t>(chunk[i * 4 + 1]) << 8) |
+                       (static_cast<uint8_t>(chunk[i * 4 + 2]) << 16) |
+                       (static_cast<uint8_t>(chunk[i * 4 + 3]) << 24);
+            }
+#endif
+        }
+
+        // Expands into all 64 steps, four at a time so the A, B, C, D roles rotate
+        // without any register shuffling.
+        template <typename V, size_t... Q>
+        [[gnu::always_inline]] static inline void rounds(std::index_sequence<Q...>, V& A, V& B, V& C, V& D, const V* M)
+        {
+            ((step<4 * Q + 0>(A, B, C, D, M),
+              step<4 * Q + 1>(D, A, B, C, M),
+              step<4 * Q + 2>(C, D, A, B, M),
+              step<4 * Q + 3>(B, C, D, A, M)), ...);
+        }
+
+        // One MD5 step; the round function and message index are resolved at compile time
+        template <int I, typename V>
+        [[gnu::always_inline]] static inline void step(V& A, const V& B, const V& C, const V& D, const V* M)
+        {
+            V F;
+            int g;
+
+            if constexpr (I < 16)
+            {
+                F = D ^ (B & (C ^ D)); // (B & C) | (~B & D)
+                g = I;
+            }
+            else if constexpr (I < 32)
+            {
+                F = C ^ (D & (B ^ C)); // (D & B) | (~D & C)
+                g = (5 * I + 1) % 16;
+            }
+            else if constexpr (I < 48)
+            {
+                F = B ^ C ^ D;
+                g = (3 * I + 5) % 16;
+            }
+            else
+            {
+                F = C ^ (B | (~D));
+                g = (7 * I) % 16;
+            }
+
+            V T = A + F + K[I] + M[g];
+            left_rotate(T, S[I]);
+            A = B + T;
+        }
+
+        // Left-rotate a 32-bit integer (or every lane of a vector) x by n bits.
+        // Works in place so vectors never cross a function boundary by value.
+        template <typename V>
+        [[gnu::always_inline]] static inline void left_rotate(V& x, int n)
         {
-            return (x << n) | (x >> (32 - n));
+            x = (x << n) | (x >> (32 - n));
         }
     };
 }
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include <stdexcept>
+
+namespace Generators
+{
+    // Position in a keyspace. 128 bits hold 95^19 and more, so printable keyspaces
+    // far beyond size_t can still be indexed, sharded and checkpointed.
+    __extension__ typedef unsigned __int128 Index;
+
+    constexpr Index MaxIndex = ~Index{0};
+
+    // Decimal representation; iostreams cannot print __int128
+    inline std::string toDecimal(Index value)
+    {
+        char digits[40];
+        size_t length = 0;
+        do
+        {
+            digits[length++] = static_cast<char>('0' + static_cast<unsigned>(value % 10));
+            value /= 10;
+        } while (value != 0);
+
+        std::reverse(digits, digits + length);
+        return std::string(digits, length);
+    }
+
+    inline Index parseIndex(std::string_view text)
+    {
+        if (text.empty())
+            throw std::invalid_argument("Expected a non-negative number, got ''.");
+
+        Index value = 0;
+        for (char c : text)
+        {
+            if (c < '0' || c > '9')
+                throw std::invalid_argument("Expected a non-negative number, got '" + std::string(text) + "'.");
+
+            unsigned digit = static_cast<unsigned>(c - '0');
+            if (value > (MaxIndex - digit) / 10)
+                throw std::overflow_error("Number '" + std::string(text) + "' exceeds 128 bits.");
+            value = value * 10 + digit;
+        }
+        return value;
+    }
+
+    // Index kept in shared memory as two relaxed 64-bit halves. The halves are
+    // only consistent with each other when guarded by a sequence counter.
+    struct SharedIndex
+    {
+        std::atomic<uint64_t> low{0};
+        std::atomic<uint64_t> high{0};
+
+        void store(Index value)
+        {
+            low.store(static_cast<uint64_t>(value), std::memory_order_relaxed);
+            high.store(static_cast<uint64_t>(value >> 64), std::memory_order_relaxed);
+        }
+
+        Index load() const
+        {
+            return (static_cast<Index>(high.load(std::memory_order_relaxed)) << 64) | low.load(std::memory_order_relaxed);
+        }
+    };
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+#include "index.h"
+#include "mask.h"
+
+namespace Generators
+{
+    // Several lengths swept as one job: the keyspaces of lengths min..max are
+    // concatenated into a single global index space, shortest first. A worker
+    // whose chunk crosses the end of one length simply continues in the next,
+    // so short lengths no longer need their own fork/join phase.
+    class Keyspace
+    {
+    public:
+        // Every length from min_size to max_size over one charset
+        Keyspace(size_t min_size, size_t max_size, const std::string& charset)
+        {
+            if (min_size == 0 || min_size > max_size)
+                throw std::invalid_argument("String sizes must satisfy 1 <= min_size <= max_size.");
+
+            for (size_t size = min_size; size <= max_size; ++size)
+                append(Mask(size, charset));
+        }
+
+        // The prefixes of mask from min_size positions up to the whole mask
+        Keyspace(const Mask& mask, size_t min_size)
+        {
+            if (min_size == 0 || min_size > mask.size())
+                throw std::invalid_argument("Minimum size must be between 1 and the mask size.");
+
+            for (size_t size = min_size; size <= mask.size(); ++size)
+                append(mask.prefix(size));
+        }
+
+        // Total number of candidates over all lengths
+        Index total() const
+        {
+            return offsets_.back();
+        }
+
+        // Shortest and longest candidate
+        size_t minSize() const
+        {
+            return masks_.front().size();
+        }
+
+        size_t maxSize() const
+        {
+            return masks_.back().size();
+        }
+
+        // Candidate at a global index
+        std::string toString(Index index) const
+        {
+            if (index >= total())
+                throw std::out_of_range("Position is out of the valid range for the given size and charset.");
+
+            size_t segment = segmentOf(index);
+            return masks_[segment].toString(index - offsets_[segment]);
+        }
+
+        // Global index of a candidate
+        Index toIndex(const std::string& str) const
+        {
+            for (size_t segment = 0; segment < masks_.size(); ++segment)
+            {
+                if (masks_[segment].size() == str.size())
+                    return offsets_[segment] + masks_[segment].toIndex(str);
+            }
+            throw std::invalid_argument("String length is outside the keyspace.");
+        }
+
+        // Splits the global range [begin, end) at length boundaries and calls
+        // f(mask, local_begin, count, global_begin) for every piece in order
+        template <typename F>
+        void forEachPiece(Index begin, Index end, F&& f) const
+        {
+            end = std::min(end, total());
+            while (begin < end)
+            {
+                size_t segment = segmentOf(begin);
+                Index piece_end = std::min(end, offsets_[segment + 1]);
+                f(masks_[segment], begin - offsets_[segment], piece_end - begin, begin);
+                begin = piece_end;
+            }
+        }
+
+    private:
+        std::vector<Mask> masks_;
+        // offsets_[i] is the global index of the first candidate of masks_[i]; one extra entry holds the total
+        std::vector<Index> offsets_{0};
+
+        void append(Mask mask)
+        {
+            Index count = mask.total();
+            if (offsets_.back() > MaxIndex - count)
+                throw std::overflow_error("Total number of combinations exceeds 128 bits.");
+
+            offsets_.push_back(offsets_.back() + count);
+            masks_.push_back(std::move(mask));
+        }
+
+        size_t segmentOf(Index index) const
+        {
+            return static_cast<size_t>(std::upper_bound(offsets_.begin(), offsets_.end(), index) - offsets_.begin()) - 1;
+        }
+    };
+}
@@ -3,18 +3,44 @@
 #include <unistd.h>    
 #include <sys/wait.h>   
 #include <vector>
+#include <thread>
 #include <functional>
+#include <optional>
 #include <stdexcept>
 #include <iostream>
 #include <cstring>      
 
+#include "scheduler.h"
+#include "placement.h"
+#include "perf_counters.h"
+
 namespace LoadBalancing
 {
+    // How LoadBalancer runs its workers
+    enum class Backend
+    {
+        Fork,   // one child process per worker
+        Thread  // one std::jthread per worker in this process
+    };
+
+    struct WorkerOptions
+    {
+        Backend backend = Backend::Fork;
+        // Pin worker i to the i-th CPU the process may use
+        bool pin = false;
+        // When set, every worker counts hardware events around its task and
+        // records them in its slot
+        Profiling::PerfCounters* counters = nullptr;
+        // Descriptors a forked worker closes before its task, e.g. a connection
+        // whose peer has to see it close as soon as the parent is gone
+        std::vector<int> close_in_child;
+    };
+
     class LoadBalancer
     {
     public:
-        LoadBalancer(int num_forks, std::function<void(int)> task)
-            : num_forks_(num_forks), task_(task)
+        LoadBalancer(int num_forks, std::function<void(int)> task, WorkerOptions options = {})
+            : num_forks_(num_forks), task_(task), options_(options)
         {
             if (num_forks_ < 1)
             {
@@ -27,8 +53,31 @@ namespace LoadBalancing
             }
         }
 
+        // Dynamic mode: every fork keeps claiming chunks from scheduler and runs
+        // chunk_task(fork_id, chunk) on each until the scheduler is drained
+        LoadBalancer(int num_forks, DynamicScheduler& scheduler, std::function<void(int, Range)> chunk_task,
+                     WorkerOptions options = {})
+            : LoadBalancer(num_forks, [&scheduler, chunk_task](int fork_id)
+                           {
+                               Range chunk;
+                               while (scheduler.claim(fork_id, chunk))
+                                   chunk_task(fork_id, chunk); }, options)
+        {
+            if (!chunk_task)
+            {
+                throw std::invalid_argument("Task function must be valid.");
+            }
+        }
+
         void start()
         {
+            if (options_.backend == Backend::Thread)
+            {
+                for (int i = 0; i < num_forks_; ++i)
+                    threads_.emplace_back([this, i]() { runTask(i); });
+                return;
+            }
+
             for (int i = 0; i < num_forks_; ++i)
             {
                 pid_t pid = fork();
@@ -41,18 +90,9 @@ namespace LoadBalancing
                 else if (pid == 0)
                 {
                     // Child process
-                    try
-                    {
-                        task_(i);
-                    }
-                    catch (const std::exception& ex)
-                    {
-                        std::cerr << "Exception in child process: " << ex.what() << std::endl;
-                    }
-                    catch (...)
-                    {
-                        std::cerr << "Unknown exception in child process." << std::endl;
-                    }
+                    for (int fd : options_.close_in_child)
+                        close(fd);
+                    runTask(i);
                     _exit(0); 
                 }
                 else
@@ -63,9 +103,14 @@ namespace LoadBalancing
             }
         }
 
-        // This function blocks until all child processes have terminated.
+        // This function blocks until all child processes (or threads) have terminated.
+        // Only children that did not exit cleanly are reported.
         void waitForChildren()
         {
+            for (std::jthread& thread : threads_)
+                thread.join();
+            threads_.clear();
+
             for (pid_t pid : child_pids_)
             {
                 int status;
@@ -74,30 +119,22 @@ namespace LoadBalancing
                 {
                     std::cerr << "Error waiting for child process " << pid << ": " << strerror(errno) << std::endl;
                 }
-                else
+                else if (WIFSIGNALED(status))
+                {
+                    std::cerr << "Child process " << pid << " terminated by signal " << WTERMSIG(status) << "." << std::endl;
+                }
+                else if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
                 {
-                    if (WIFEXITED(status)) // Exited
-                    {
-                        int exit_status = WEXITSTATUS(status);
-                        std::cout << "Child process " << pid << " exited with status " << exit_status << "." << std::endl;
-                    }
-                    else if (WIFSIGNALED(status)) // Terminated
-                    {
-                        int term_signal = WTERMSIG(status);
-                        std::cout << "Child process " << pid << " terminated by signal " << term_signal << "." << std::endl;
-                    }
-                    else // Different reason
-                    {
-                        std::cout << "Child process " << pid << " terminated abnormally." << std::endl;
-                    }
+                    std::cerr << "Child process " << pid << " exited abnormally." << std::endl;
                 }
             }
+            child_pids_.clear();
         }
 
         ~LoadBalancer()
         {
-            // Check if there are any unwaited child processes
-            if (!child_pids_.empty())
+            // Check if there are any unwaited child processes or threads
+            if (!child_pids_.empty() || !threads_.empty())
             {
                 waitForChildren();
             }
@@ -106,6 +143,34 @@ namespace LoadBalancing
     private:
         int num_forks_;                             
         std::function<void(int)> task_;                 
+        WorkerOptions options_;
         std::vector<pid_t> child_pids_;              
+        std::vector<std::jthread> threads_;
+
+        void runTask(int worker_id)
+        {
+            if (options_.pin)
+                Placement::pinCurrentThread(worker_id);
+
+            std::optional<Profiling::ThreadCounters> counters;
+            if (options_.counters != nullptr)
+                counters.emplace();
+
+            try
+            {
+                task_(worker_id);
+            }
+            catch (const std::exception& ex)
+            {
+                std::cerr << "Exception in worker " << worker_id << ": " << ex.what() << std::endl;
+            }
+            catch (...)
+            {
+                std::cerr << "Unknown exception in worker " << worker_id << "." << std::endl;
+            }
+
+            if (counters)
+                options_.counters->record(worker_id, counters->stop(), counters->error());
+        }
     };
 }
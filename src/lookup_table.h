@@ -0,0 +1,560 @@
+#pragma once
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <optional>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "algorithms.h"
+#include "generator.h"
+#include "keyspace.h"
+#include "load_balancer.h"
+#include "mapped_file.h"
+#include "scheduler.h"
+#include "shared_memory.h"
+#include "telemetry.h"
+
+namespace Lookup
+{
+    // On-disk table of every candidate of a keyspace, sorted by a truncated digest.
+    //
+    // A page holds the header and the keyspace; the entries follow from
+    // EntriesOffset on. Each entry is the first 8 bytes of the candidate's digest
+    // (read big-endian, so numeric order is byte order) and its keyspace index,
+    // which Keyspace::toString() turns back into the plaintext:
+    //
+    //   [TableHeader][charset][mask] ... | key index | key index | ...
+    //
+    // Truncation makes equal keys possible, so a lookup rehashes every candidate
+    // under the queried key and only returns the one with the full digest.
+    struct TableHeader
+    {
+        static constexpr char Magic[8] = {'K', 'S', 'T', 'A', 'B', 'L', 'E', '1'};
+
+        char magic[8];
+        uint32_t algorithm;
+        uint32_t reserved;
+        uint64_t count;
+        uint64_t min_size;
+        uint64_t size;
+        uint64_t charset_size;
+        uint64_t mask_size;
+    };
+
+    struct TableEntry
+    {
+        uint64_t key;
+        uint64_t index;
+
+        bool operator<(const TableEntry& other) const
+        {
+            return key != other.key ? key < other.key : index < other.index;
+        }
+    };
+
+    // Entries start on their own page after the header
+    static constexpr size_t EntriesOffset = 4096;
+
+    // Table key of a digest given as bytes: its first 8 bytes, big-endian
+    inline uint64_t tableKey(const uint8_t* digest)
+    {
+        uint64_t key;
+        std::memcpy(&key, digest, sizeof(key));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        key = __builtin_bswap64(key);
+#endif
+        return key;
+    }
+
+    struct TableConfig
+    {
+        size_t size = 5;
+        // Shortest length in the table; 0 stores only size
+        size_t min_size = 0;
+        std::string charset = "abcdefghijklmnopqrstuvwxyz";
+        // Per-position pattern; replaces size and charset when set
+        std::string mask;
+        Hashing::Algorithm algorithm = Hashing::Algorithm::Md5;
+        std::string output_file;
+        int num_forks = 1;
+        LoadBalancing::WorkerOptions workers;
+        // Smallest chunk of the keyspace a worker claims, and the SIMD width it hashes with
+        size_t min_chunk = 1 << 16;
+        Hashing::Isa isa = Hashing::Md5Batch::detectIsa();
+        // Sorted runs are spilled once the workers together hold this many bytes
+        size_t memory = size_t{1} << 30;
+        bool progress = false;
+    };
+
+    struct TableStats
+    {
+        uint64_t entries = 0;
+        size_t runs = 0;
+        double hash_ms = 0;
+        double merge_ms = 0;
+    };
+
+    // Builds a table in two parallel passes, never holding more than
+    // TableConfig::memory of entries in RAM:
+    //
+    //  1. Workers claim chunks of the keyspace, hash them into a buffer and,
+    //     whenever it is full, sort it and append it to their own run file.
+    //  2. The key range is cut into buckets by the top bits of the key. Every
+    //     run is sorted, so a bucket is one slice per run, found by binary
+    //     search; its place in the output is the sum of the buckets before it.
+    //     Workers claim buckets, merge their slices and pwrite() the result
+    //     straight into place, so no two workers ever touch the same bytes.
+    class TableBuilder
+    {
+    public:
+        explicit TableBuilder(TableConfig config)
+            : config_(std::move(config)), keyspace_(keyspaceOf(config_))
+        {
+            if (config_.output_file.empty())
+                throw std::invalid_argument("The table needs an output file.");
+            if (config_.num_forks < 1)
+                throw std::invalid_argument("Number of forks must be at least 1.");
+            if (keyspace_.total() > Generators::Index{UINT64_MAX})
+                throw std::invalid_argument("A table holds at most 2^64 candidates; use a smaller keyspace.");
+            if (config_.mask.size() + config_.charset.size() > EntriesOffset - sizeof(TableHeader))
+                throw std::invalid_argument("The charset or mask is too long for the table header.");
+        }
+
+        TableStats build()
+        {
+            TableStats stats;
+            stats.entries = static_cast<uint64_t>(keyspace_.total());
+            size_t run_entries = std::max<size_t>(config_.memory / sizeof(TableEntry) / config_.num_forks, 1 << 16);
+            std::vector<std::string> run_files;
+            for (int i = 0; i < config_.num_forks; ++i)
+                run_files.push_back(config_.output_file + ".run" + std::to_string(i));
+
+            try
+            {
+                auto start_time = std::chrono::steady_clock::now();
+                std::vector<Run> runs = writeRuns(run_files, run_entries);
+                auto hashed_time = std::chrono::steady_clock::now();
+                mergeRuns(run_files, runs, stats.entries);
+                auto end_time = std::chrono::steady_clock::now();
+
+                stats.runs = runs.size();
+                stats.hash_ms = std::chrono::duration<double, std::milli>(hashed_time - start_time).count();
+                stats.merge_ms = std::chrono::duration<double, std::milli>(end_time - hashed_time).count();
+            }
+            catch (...)
+            {
+                for (const std::string& path : run_files)
+                    unlink(path.c_str());
+                throw;
+            }
+
+            for (const std::string& path : run_files)
+                unlink(path.c_str());
+            return stats;
+        }
+
+    private:
+        // Sorted piece of one worker's run file, in entries
+        struct Run
+        {
+            int worker;
+            uint64_t offset;
+            uint64_t count;
+        };
+
+        // Buckets of the merge pass, by the top bits of the key
+        static constexpr int BucketBits = 12;
+        static constexpr size_t Buckets = size_t{1} << BucketBits;
+        // Entries a merging worker collects before each pwrite()
+        static constexpr size_t MergeBuffer = size_t{1} << 16;
+
+        TableConfig config_;
+        Generators::Keyspace keyspace_;
+
+        std::vector<Run> writeRuns(const std::vector<std::string>& run_files, size_t run_entries)
+        {
+            uint64_t total = static_cast<uint64_t>(keyspace_.total());
+            size_t capacity = static_cast<size_t>(total / run_entries) + config_.num_forks;
+            LoadBalancing::SharedMemory<Run> runs(capacity);
+            LoadBalancing::SharedMemory<std::atomic<size_t>> run_count;
+            Monitoring::Telemetry telemetry(config_.num_forks, keyspace_.total());
+            LoadBalancing::DynamicScheduler scheduler({{0, keyspace_.total()}}, config_.num_forks, config_.min_chunk,
+                                                      std::max(config_.min_chunk, LoadBalancing::DynamicScheduler::DefaultMaxChunk));
+
+            LoadBalancing::LoadBalancer lb(config_.num_forks, [&](int worker_id)
+                                           { Hashing::withAlgorithm(config_.algorithm, [&](auto hasher)
+                                                                    { hashRuns<typename decltype(hasher)::type>(worker_id, run_files[worker_id], run_entries,
+                                                                                                                scheduler, runs.get(), *run_count, telemetry.slot(worker_id)); }); },
+                                           config_.workers);
+            lb.start();
+            {
+                std::optional<Monitoring::ProgressView> view;
+                if (config_.progress)
+                    view.emplace(telemetry);
+                lb.waitForChildren();
+            }
+
+            if (telemetry.processed() != total)
+                throw std::runtime_error("Workers hashed " + std::to_string(telemetry.processed()) + " of " + std::to_string(total) +
+                                         " candidates.");
+            size_t count = std::min(run_count->load(), capacity);
+            return std::vector<Run>(runs.get(), runs.get() + count);
+        }
+
+        template <typename Hasher>
+        void hashRuns(int worker_id, const std::string& path, size_t run_entries, LoadBalancing::DynamicScheduler& scheduler,
+                      Run* runs, std::atomic<size_t>& run_count, Monitoring::WorkerSlot& slot) const
+        {
+            int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (fd < 0)
+                throw std::runtime_error("Unable to open file '" + path + "': " + strerror(errno));
+
+            std::vector<TableEntry> buffer;
+            buffer.reserve(run_entries);
+            uint64_t written = 0;
+
+            // Sorts the buffer and appends it to the run file as one run
+            auto spill = [&]()
+            {
+                if (buffer.empty())
+                    return;
+                std::sort(buffer.begin(), buffer.end());
+                writeAll(fd, buffer.data(), buffer.size() * sizeof(TableEntry), path);
+                runs[run_count.fetch_add(1)] = {worker_id, written, buffer.size()};
+                written += buffer.size();
+                buffer.clear();
+            };
+
+            Hasher hasher(config_.isa);
+            size_t lanes = hasher.lanes();
+            typename Hasher::Digest digests[Hashing::Md5Batch::MaxLanes];
+            std::string_view views[Hashing::Md5Batch::MaxLanes];
+
+            LoadBalancing::Range chunk;
+            while (scheduler.claim(worker_id, chunk))
+            {
+                keyspace_.forEachPiece(chunk.begin, chunk.end, [&](const Generators::Mask& mask, Generators::Index local,
+                                                                   Generators::Index count, Generators::Index index)
+                                       {
+                    Generators::StringGenerator generator(mask, local, count);
+                    size_t size = generator.size();
+                    std::vector<char> candidates(size * lanes);
+
+                    while (generator.hasNext())
+                    {
+                        size_t n = 0;
+                        for (; n < lanes && generator.next(candidates.data() + n * size); ++n)
+                            views[n] = std::string_view(candidates.data() + n * size, size);
+
+                        hasher.hashBatch(views, n, digests);
+                        for (size_t i = 0; i < n; ++i)
+                        {
+                            buffer.push_back({tableKey(Hasher::toBytes(digests[i]).data()), static_cast<uint64_t>(index + i)});
+                            if (buffer.size() == run_entries)
+                                spill();
+                        }
+                        index += n;
+                        slot.advance(n, index);
+                    } });
+            }
+            spill();
+            close(fd);
+        }
+
+        void mergeRuns(const std::vector<std::string>& run_files, const std::vector<Run>& runs, uint64_t entries) const
+        {
+            // Mapped before the fork, so every worker shares the page cache copy
+            std::vector<Storage::MappedFile> files;
+            for (const std::string& path : run_files)
+                files.emplace_back(path);
+
+            // bounds[r][b] is where bucket b starts in run r
+            std::vector<const TableEntry*> data;
+            std::vector<std::vector<uint64_t>> bounds;
+            std::vector<uint64_t> offsets(Buckets + 1, 0);
+            for (const Run& run : runs)
+            {
+                const TableEntry* begin = reinterpret_cast<const TableEntry*>(files[run.worker].data()) + run.offset;
+                data.push_back(begin);
+                std::vector<uint64_t> bound(Buckets + 1, run.count);
+                for (size_t b = 0; b < Buckets; ++b)
+                {
+                    uint64_t first = static_cast<uint64_t>(b) << (64 - BucketBits);
+                    bound[b] = std::lower_bound(begin, begin + run.count, first, [](const TableEntry& entry, uint64_t key)
+                                                { return entry.key < key; }) - begin;
+                }
+                for (size_t b = 0; b < Buckets; ++b)
+                    offsets[b + 1] += bound[b + 1] - bound[b];
+                bounds.push_back(std::move(bound));
+            }
+            for (size_t b = 0; b < Buckets; ++b)
+                offsets[b + 1] += offsets[b];
+            if (offsets[Buckets] != entries)
+                throw std::runtime_error("Runs hold " + std::to_string(offsets[Buckets]) + " of " + std::to_string(entries) + " entries.");
+
+            int fd = open(config_.output_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (fd < 0)
+                throw std::runtime_error("Unable to open file '" + config_.output_file + "': " + strerror(errno));
+
+            try
+            {
+                writeHeader(fd, entries);
+                if (ftruncate(fd, static_cast<off_t>(EntriesOffset + entries * sizeof(TableEntry))) != 0)
+                    throw std::runtime_error("Unable to resize file '" + config_.output_file + "': " + strerror(errno));
+
+                LoadBalancing::SharedMemory<std::atomic<uint64_t>> merged;
+                LoadBalancing::DynamicScheduler scheduler({{0, Buckets}}, config_.num_forks, 1, 1);
+                LoadBalancing::LoadBalancer lb(config_.num_forks, scheduler, [&](int, LoadBalancing::Range chunk)
+                                               {
+                    for (Generators::Index b = chunk.begin; b < chunk.end; ++b)
+                    {
+                        size_t bucket = static_cast<size_t>(b);
+                        mergeBucket(fd, bucket, data, bounds, offsets[bucket]);
+                        merged->fetch_add(offsets[bucket + 1] - offsets[bucket]);
+                    } },
+                                               config_.workers);
+                lb.start();
+                lb.waitForChildren();
+
+                // A worker that failed leaves a hole of zeros; catch it before anyone queries it
+                if (merged->load() != entries)
+                    throw std::runtime_error("Workers merged " + std::to_string(merged->load()) + " of " + std::to_string(entries) + " entries.");
+            }
+            catch (...)
+            {
+                close(fd);
+                throw;
+            }
+            close(fd);
+        }
+
+        // K-way merge of one bucket's slices, written at its final position
+        void mergeBucket(int fd, size_t bucket, const std::vector<const TableEntry*>& data, const std::vector<std::vector<uint64_t>>& bounds,
+                         uint64_t offset) const
+        {
+            // (next entry, run) pairs, smallest entry on top
+            auto greater = [&data](const std::pair<uint64_t, size_t>& a, const std::pair<uint64_t, size_t>& b)
+            { return data[b.second][b.first] < data[a.second][a.first]; };
+            std::priority_queue<std::pair<uint64_t, size_t>, std::vector<std::pair<uint64_t, size_t>>, decltype(greater)> heap(greater);
+            for (size_t r = 0; r < data.size(); ++r)
+            {
+                if (bounds[r][bucket] < bounds[r][bucket + 1])
+                    heap.push({bounds[r][bucket], r});
+            }
+
+            std::vector<TableEntry> buffer;
+            buffer.reserve(MergeBuffer);
+            auto flush = [&]()
+            {
+                writeAllAt(fd, buffer.data(), buffer.size() * sizeof(TableEntry), EntriesOffset + offset * sizeof(TableEntry));
+                offset += buffer.size();
+                buffer.clear();
+            };
+
+            while (!heap.empty())
+            {
+                auto [position, r] = heap.top();
+                heap.pop();
+                buffer.push_back(data[r][position]);
+                if (position + 1 < bounds[r][bucket + 1])
+                    heap.push({position + 1, r});
+                if (buffer.size() == MergeBuffer)
+                    flush();
+            }
+            if (!buffer.empty())
+                flush();
+        }
+
+        void writeHeader(int fd, uint64_t entries) const
+        {
+            std::vector<char> page(EntriesOffset, '\0');
+            TableHeader header;
+            std::memset(&header, 0, sizeof(header));
+            std::memcpy(header.magic, TableHeader::Magic, sizeof(header.magic));
+            header.algorithm = static_cast<uint32_t>(config_.algorithm);
+            header.count = entries;
+            header.min_size = keyspace_.minSize();
+            header.size = keyspace_.maxSize();
+            header.charset_size = config_.mask.empty() ? config_.charset.size() : 0;
+            header.mask_size = config_.mask.size();
+
+            std::memcpy(page.data(), &header, sizeof(header));
+            char* strings = page.data() + sizeof(header);
+            if (config_.mask.empty())
+                std::memcpy(strings, config_.charset.data(), config_.charset.size());
+            else
+                std::memcpy(strings, config_.mask.data(), config_.mask.size());
+            writeAllAt(fd, page.data(), page.size(), 0);
+        }
+
+        static void writeAll(int fd, const void* data, size_t size, const std::string& path)
+        {
+            const char* bytes = static_cast<const char*>(data);
+            while (size != 0)
+            {
+                ssize_t result = write(fd, bytes, size);
+                if (result < 0 && errno == EINTR)
+                    continue;
+                if (result < 0)
+                    throw std::runtime_error("Unable to write file '" + path + "': " + strerror(errno));
+                bytes += result;
+                size -= static_cast<size_t>(result);
+            }
+        }
+
+        void writeAllAt(int fd, const void* data, size_t size, uint64_t offset) const
+        {
+            const char* bytes = static_cast<const char*>(data);
+            while (size != 0)
+            {
+                ssize_t result = pwrite(fd, bytes, size, static_cast<off_t>(offset));
+                if (result < 0 && errno == EINTR)
+                    continue;
+                if (result < 0)
+                    throw std::runtime_error("Unable to write file '" + config_.output_file + "': " + strerror(errno));
+                bytes += result;
+                size -= static_cast<size_t>(result);
+                offset += static_cast<uint64_t>(result);
+            }
+        }
+
+        static Generators::Keyspace keyspaceOf(const TableConfig& config)
+        {
+            if (config.mask.empty())
+                return Generators::Keyspace(config.min_size == 0 ? config.size : config.min_size, config.size, config.charset);
+
+            Generators::Mask mask = Generators::Mask::parse(config.mask);
+            return Generators::Keyspace(mask, config.min_size == 0 ? mask.size() : config.min_size);
+        }
+    };
+
+    // Read side of a table: mapped once, each lookup is an interpolation search
+    // over the uniformly distributed keys, which lands within a few entries of
+    // the answer, followed by a short binary search.
+    class SortedTable
+    {
+    public:
+        explicit SortedTable(const std::string& path)
+            : file_(path), keyspace_(readKeyspace(file_, path))
+        {
+            madvise(const_cast<char*>(file_.data()), file_.size(), MADV_RANDOM);
+        }
+
+        Hashing::Algorithm algorithm() const
+        {
+            return static_cast<Hashing::Algorithm>(header().algorithm);
+        }
+
+        uint64_t count() const
+        {
+            return header().count;
+        }
+
+        const Generators::Keyspace& keyspace() const
+        {
+            return keyspace_;
+        }
+
+        // Plaintext of a hex digest, or nothing when no candidate of the keyspace has it
+        std::optional<std::string> find(std::string_view hex) const
+        {
+            return Hashing::withAlgorithm(algorithm(), [&](auto hasher) -> std::optional<std::string>
+                                          {
+                using Hasher = typename decltype(hasher)::type;
+                typename Hasher::Digest digest = Hasher::fromHex(hex);
+                uint64_t key = tableKey(Hasher::toBytes(digest).data());
+
+                // Every entry with this key is a candidate; only the full digest decides
+                for (uint64_t i = lowerBound(key); i < count() && entries()[i].key == key; ++i)
+                {
+                    std::string plaintext = keyspace_.toString(entries()[i].index);
+                    if (Hasher::digest(plaintext) == digest)
+                        return plaintext;
+                }
+                return std::nullopt; });
+        }
+
+    private:
+        Storage::MappedFile file_;
+        Generators::Keyspace keyspace_;
+
+        const TableHeader& header() const
+        {
+            return *reinterpret_cast<const TableHeader*>(file_.data());
+        }
+
+        const TableEntry* entries() const
+        {
+            return reinterpret_cast<const TableEntry*>(file_.data() + EntriesOffset);
+        }
+
+        // First entry whose key is not below key
+        uint64_t lowerBound(uint64_t key) const
+        {
+            const TableEntry* entry = entries();
+            uint64_t low = 0;
+            uint64_t high = count();
+
+            // Interpolate while the range is wide and the key lies inside it
+            while (high - low > 64)
+            {
+                uint64_t first = entry[low].key;
+                uint64_t last = entry[high - 1].key;
+                if (key <= first)
+                    return low;
+                if (key > last)
+                    return high;
+
+                unsigned __int128 span = static_cast<unsigned __int128>(key - first) * (high - 1 - low);
+                uint64_t guess = low + static_cast<uint64_t>(span / (last - first));
+
+                // A small window around the guess; if the key is outside it, the
+                // window still cuts the range to one side of the guess
+                uint64_t window = 32;
+                uint64_t below = guess > low + window ? guess - window : low;
+                uint64_t above = std::min(high, guess + window);
+                if (entry[below].key >= key)
+                    high = below + 1;
+                else if (above < high && entry[above - 1].key < key)
+                    low = above;
+                else
+                {
+                    low = below;
+                    high = above;
+                }
+            }
+
+            return std::lower_bound(entry + low, entry + high, key, [](const TableEntry& e, uint64_t k) { return e.key < k; }) - entry;
+        }
+
+        static Generators::Keyspace readKeyspace(const Storage::MappedFile& file, const std::string& path)
+        {
+            if (file.size() < EntriesOffset)
+                throw std::runtime_error("File '" + path + "' is not a lookup table.");
+
+            TableHeader header;
+            std::memcpy(&header, file.data(), sizeof(header));
+            if (std::memcmp(header.magic, TableHeader::Magic, sizeof(header.magic)) != 0)
+                throw std::runtime_error("File '" + path + "' is not a lookup table.");
+            if (header.charset_size + header.mask_size > EntriesOffset - sizeof(TableHeader) ||
+                file.size() != EntriesOffset + header.count * sizeof(TableEntry))
+                throw std::runtime_error("Lookup table '" + path + "' is truncated or corrupt.");
+
+            const char* strings = file.data() + sizeof(TableHeader);
+            if (header.mask_size == 0)
+                return Generators::Keyspace(header.min_size, header.size, std::string(strings, header.charset_size));
+            return Generators::Keyspace(Generators::Mask::parse(std::string(strings, header.mask_size)), header.min_size);
+        }
+    };
+}
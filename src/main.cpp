@@ -1,5 +1,13 @@
+#include <unistd.h>
 #include <iostream>
 #include <chrono>
+#include <thread>
+#include <map>
+#include <optional>
+#include <fstream>
+#include <random>
+#include <set>
+#include <initializer_list>
 
 #define NO_PYTHON 0 // Set to 0 to ENABLE python and generate plot with results
 #if NO_PYTHON == 0
@@ -9,49 +17,544 @@
 #include "hasher.h"
 #include "generator.h"
 #include "load_balancer.h"
+#include "worker_pool.h"
 #include "results_writer.h"
+#include "cracker.h"
+#include "cluster.h"
+#include "lookup_table.h"
+#include "autotune.h"
+#include "options.h"
 
-int main()
+// Keyspace and targets of a job, shared by the "crack" and "coordinate" modes
+static void readJob(const Cli::Options& options, Cracking::CrackConfig& config)
+{
+    config.size = options.getSize("max-size", options.getSize("size", config.size));
+    config.min_size = options.getSize("min-size", 0);
+    config.charset = options.get("charset", config.charset);
+    config.mask = options.get("mask");
+    config.targets_file = options.get("targets");
+    config.algorithm = Hashing::parseAlgorithm(options.get("hash", "md5"));
+
+    // "--order random" shuffles blocks of candidates with a fresh key unless
+    // "--seed" repeats one; "--order strided" spreads them with a fixed step
+    config.order = Generators::parseOrder(options.get("order", "linear"));
+    std::random_device entropy;
+    config.seed = options.getSize("seed", (uint64_t{entropy()} << 32) | entropy());
+
+    // "--shard K/N" sweeps the K-th (from 0) of N equal parts of the keyspace
+    if (options.has("shard"))
+    {
+        std::string shard = options.get("shard");
+        size_t slash = shard.find('/');
+        if (slash == std::string::npos)
+            throw std::invalid_argument("Option --shard expects K/N, got '" + shard + "'.");
+        config.shard = static_cast<size_t>(Generators::parseIndex(shard.substr(0, slash)));
+        config.shards = static_cast<size_t>(Generators::parseIndex(shard.substr(slash + 1)));
+    }
+
+    // Salted targets are given as "hex:salt"
+    for (const std::string& target : options.positional())
+    {
+        size_t colon = target.find(':');
+        config.targets.push_back(Hashing::keyFromHex(config.algorithm, target.substr(0, colon)));
+        if (colon != std::string::npos)
+            config.salts.push_back(target.substr(colon + 1));
+    }
+}
+
+// Local parallelism of a sweep, shared by the "crack", "dump", "table" and "work" modes
+static void readWorkers(const Cli::Options& options, Cracking::CrackConfig& config)
+{
+    config.num_forks = options.getInt("forks", static_cast<int>(std::max(1u, std::thread::hardware_concurrency())));
+    if (options.has("isa"))
+        config.isa = Hashing::Md5Batch::parseIsa(options.get("isa"));
+
+    std::string engine = options.get("engine", "batch");
+    if (engine == "incremental")
+        config.engine = Cracking::Engine::Incremental;
+    else if (engine != "batch")
+        throw std::invalid_argument("Unknown engine '" + engine + "', expected 'batch' or 'incremental'.");
+
+    std::string schedule = options.get("schedule", "dynamic");
+    if (schedule == "static")
+        config.schedule = Cracking::Schedule::Static;
+    else if (schedule != "dynamic")
+        throw std::invalid_argument("Unknown schedule '" + schedule + "', expected 'static' or 'dynamic'.");
+    config.min_chunk = options.getSize("chunk", config.min_chunk);
+    if (config.min_chunk == 0)
+        throw std::invalid_argument("Option --chunk must be at least 1.");
+
+    std::string backend = options.get("backend", "fork");
+    if (backend == "thread")
+        config.workers.backend = LoadBalancing::Backend::Thread;
+    else if (backend != "fork")
+        throw std::invalid_argument("Unknown backend '" + backend + "', expected 'fork' or 'thread'.");
+    config.workers.pin = options.has("pin");
+    config.numa_local = options.has("numa");
+}
+
+// Takes whatever --forks, --chunk and --isa left open from the profile "autotune"
+// saved for this host and the job's hash function, unless --no-profile is given.
+// Call once the job's algorithm is known; returns whether a profile was applied.
+static bool applyProfile(const Cli::Options& options, Cracking::CrackConfig& config)
+{
+    if (options.has("no-profile"))
+        return false;
+
+    std::string path = options.get("profile", Tuning::defaultProfilePath(config.algorithm));
+    std::optional<Tuning::Profile> profile = Tuning::Profile::load(path);
+    if (!profile || profile->host != Tuning::hostSignature() || profile->algorithm != config.algorithm ||
+        !Hashing::Md5Batch::isSupported(profile->isa))
+        return false;
+
+    if (!options.has("forks"))
+        config.num_forks = profile->workers;
+    if (!options.has("chunk"))
+        config.min_chunk = profile->chunk;
+    if (!options.has("isa"))
+        config.isa = profile->isa;
+    std::cerr << "Using tuned profile '" << path << "': " << config.num_forks << " workers, chunk " << config.min_chunk
+              << ", " << Hashing::Md5Batch::isaName(config.isa) << std::endl;
+    return true;
+}
+
+// One line of hardware counters; events the machine could not count are skipped
+static void printCounters(const std::string& label, const Profiling::Counts& counts, uint64_t processed)
+{
+    const char* separator = ": ";
+    std::cout << label;
+    for (int event = 0; event < Profiling::EventCount; ++event)
+    {
+        if (counts.has(event))
+        {
+            std::cout << separator << counts[event] << " " << Profiling::eventName(event);
+            separator = ", ";
+        }
+    }
+    if (counts.has(Profiling::Cycles) && counts.has(Profiling::Instructions))
+        std::cout << separator << "IPC " << counts.ipc();
+    if (counts.has(Profiling::Cycles))
+        std::cout << separator << counts.perCycle(processed) << " hashes/cycle";
+    if (counts.available == 0)
+        std::cout << ": none available";
+    std::cout << std::endl;
+}
+
+// Recovers the keys of the given digests by sweeping one keyspace length, or
+// several lengths as one job
+static int runCrack(const Cli::Options& options)
+{
+    Cracking::CrackConfig config;
+    readJob(options, config);
+    readWorkers(options, config);
+    applyProfile(options, config);
+    config.wordlist = options.get("wordlist");
+    config.rules_file = options.get("rules");
+
+    // "--salted before" is md5(salt . pw), "--salted after" md5(pw . salt);
+    // "--iterations N" is md5 applied N times over the hex of the previous round
+    std::string salted = options.get("salted");
+    if (salted == "before")
+        config.construction = Cracking::Construction::SaltBefore;
+    else if (salted == "after")
+        config.construction = Cracking::Construction::SaltAfter;
+    else if (!salted.empty())
+        throw std::invalid_argument("Unknown salt position '" + salted + "', expected 'before' or 'after'.");
+    if (options.has("iterations"))
+    {
+        if (!salted.empty())
+            throw std::invalid_argument("Options --salted and --iterations cannot be combined.");
+        config.construction = Cracking::Construction::Iterated;
+        config.iterations = options.getSize("iterations", config.iterations);
+    }
+
+    // A resumed run takes the keyspace and the unfinished ranges from the checkpoint
+    // and keeps checkpointing into the same file unless told otherwise
+    if (options.has("resume"))
+    {
+        std::string path = options.get("resume");
+        Recovery::Checkpoint checkpoint = Recovery::Checkpoint::load(path);
+        if ((options.has("size") || options.has("max-size")) && config.size != checkpoint.size)
+            throw std::invalid_argument("Option --size does not match the checkpoint.");
+        if (options.has("min-size") && config.min_size != checkpoint.keyspace().minSize())
+            throw std::invalid_argument("Option --min-size does not match the checkpoint.");
+        if (options.has("charset") && config.charset != checkpoint.charset)
+            throw std::invalid_argument("Option --charset does not match the checkpoint.");
+        if (options.has("mask") && config.mask != checkpoint.mask)
+            throw std::invalid_argument("Option --mask does not match the checkpoint.");
+        if ((options.has("order") && config.order != checkpoint.order) || (options.has("seed") && config.seed != checkpoint.seed))
+            throw std::invalid_argument("Options --order and --seed do not match the checkpoint.");
+        if (checkpoint.ranges.empty())
+        {
+            std::cout << "Checkpoint '" << path << "' has no unfinished ranges." << std::endl;
+            return 1;
+        }
+
+        config.size = checkpoint.size;
+        config.min_size = checkpoint.min_size;
+        config.charset = checkpoint.charset;
+        config.mask = checkpoint.mask;
+        config.order = checkpoint.order;
+        config.seed = checkpoint.seed;
+        config.ranges = checkpoint.ranges;
+        config.checkpoint_file = path;
+        std::cout << "Resuming " << Generators::toDecimal(checkpoint.remaining()) << " candidates in " << checkpoint.ranges.size() << " ranges." << std::endl;
+    }
+
+    config.checkpoint_file = options.get("checkpoint", config.checkpoint_file);
+    size_t interval = options.getSize("checkpoint-interval", 5);
+    if (interval == 0)
+        throw std::invalid_argument("Option --checkpoint-interval must be at least 1 second.");
+    config.checkpoint_interval = std::chrono::milliseconds(interval * 1000);
+    config.progress = options.has("progress") || (isatty(STDERR_FILENO) && !options.has("quiet"));
+    config.perf = options.has("perf");
+
+    Cracking::Cracker cracker(std::move(config));
+    std::cout << "Loaded " << cracker.targetCount() << " target digests." << std::endl;
+    Cracking::CrackResult result = cracker.run();
+
+    for (const Cracking::Match& match : result.matches)
+    {
+        std::cout << cracker.digestOf(match) << ":" << cracker.keyOf(match)
+                  << " (index " << Generators::toDecimal(match.index) << ", after " << match.elapsed_ns / 1e6 << " ms)" << std::endl;
+    }
+
+    if (result.matches.empty())
+        std::cout << "No match found in " << result.processed() << " candidates." << std::endl;
+    else
+        std::cout << "Time to first hit: " << result.firstHitMs() << " ms" << std::endl;
+    std::cout << "Job finished in " << result.elapsed_ms << " ms" << std::endl;
+    std::cout << "Hashed " << result.processed() << " candidates at " << result.rate() / 1e6
+              << " MH/s" << std::endl;
+
+    if (options.has("stats"))
+    {
+        for (size_t i = 0; i < result.workers.size(); ++i)
+        {
+            const Monitoring::WorkerStats& worker = result.workers[i];
+            std::cout << "Worker " << i << ": " << worker.processed << " candidates, " << worker.rate / 1e6
+                      << " MH/s, last position " << Generators::toDecimal(worker.position) << ", " << worker.matches << " matches" << std::endl;
+            if (i < result.counters.size())
+                printCounters("  counters", result.counters[i], worker.processed);
+        }
+    }
+
+    if (!result.counters.empty())
+    {
+        Profiling::Counts total;
+        for (const Profiling::Counts& counts : result.counters)
+            total += counts;
+        printCounters("Counters", total, result.processed());
+        if (!result.counters_unavailable.empty())
+            std::cout << "Some counters are unavailable: " << result.counters_unavailable << std::endl;
+    }
+
+    return result.matches.empty() ? 1 : 0;
+}
+
+// Hashes every candidate of a keyspace or wordlist into --output, e.g. to build
+// lookup tables; any digests given are reported as in "crack"
+static int runDump(const Cli::Options& options)
+{
+    Cracking::CrackConfig config;
+    readJob(options, config);
+    readWorkers(options, config);
+    applyProfile(options, config);
+    config.wordlist = options.get("wordlist");
+    config.rules_file = options.get("rules");
+    config.output_file = options.get("output");
+    if (config.output_file.empty())
+        throw std::invalid_argument("Option --output is required.");
+    config.output_format = Output::parseFormat(options.get("format", "text"));
+    if (options.has("iterations"))
+    {
+        config.construction = Cracking::Construction::Iterated;
+        config.iterations = options.getSize("iterations", config.iterations);
+    }
+    config.progress = options.has("progress") || (isatty(STDERR_FILENO) && !options.has("quiet"));
+
+    Cracking::Cracker cracker(std::move(config));
+    Cracking::CrackResult result = cracker.run();
+
+    for (const Cracking::Match& match : result.matches)
+        std::cout << cracker.digestOf(match) << ":" << cracker.keyOf(match) << std::endl;
+    std::cout << "Hashed " << result.processed() << " candidates in " << result.elapsed_ms << " ms ("
+              << result.rate() / 1e6 << " MH/s), wrote " << result.output_bytes << " bytes to '"
+              << options.get("output") << "'" << std::endl;
+    return 0;
+}
+
+// Sweeps a keyspace once into a sorted digest table for "lookup"
+static int runTable(const Cli::Options& options)
+{
+    Cracking::CrackConfig job;
+    readJob(options, job);
+    readWorkers(options, job);
+    bool profiled = applyProfile(options, job);
+    if (!job.targets.empty() || !job.targets_file.empty() || job.shards != 1)
+        throw std::invalid_argument("A table covers a whole keyspace; targets and shards are not used.");
+
+    Lookup::TableConfig config;
+    config.size = job.size;
+    config.min_size = job.min_size;
+    config.charset = job.charset;
+    config.mask = job.mask;
+    config.algorithm = job.algorithm;
+    config.num_forks = job.num_forks;
+    config.workers = job.workers;
+    if (profiled || options.has("chunk"))
+        config.min_chunk = job.min_chunk;
+    config.isa = job.isa;
+    config.output_file = options.get("output");
+    config.memory = options.getSize("memory", config.memory >> 20) << 20;
+    config.progress = options.has("progress") || (isatty(STDERR_FILENO) && !options.has("quiet"));
+
+    Lookup::TableStats stats = Lookup::TableBuilder(std::move(config)).build();
+    std::cout << "Wrote " << stats.entries << " entries to '" << options.get("output") << "': hashed into " << stats.runs
+              << " sorted runs in " << stats.hash_ms << " ms, merged in " << stats.merge_ms << " ms" << std::endl;
+    return 0;
+}
+
+// Answers digests from a table built by "table"
+static int runLookup(const Cli::Options& options)
+{
+    Lookup::SortedTable table(options.get("table"));
+
+    std::vector<std::string> digests = options.positional();
+    if (options.has("targets"))
+    {
+        std::ifstream file(options.get("targets"));
+        if (!file.is_open())
+            throw std::runtime_error("Unable to open file '" + options.get("targets") + "'");
+        std::string line;
+        while (std::getline(file, line))
+        {
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            if (!line.empty() && line.front() != '#')
+                digests.push_back(line);
+        }
+    }
+
+    // A malformed digest only fails its own line; the rest are still looked up
+    size_t found = 0;
+    size_t invalid = 0;
+    for (const std::string& digest : digests)
+    {
+        auto start_time = std::chrono::steady_clock::now();
+        std::optional<std::string> plaintext;
+        try
+        {
+            plaintext = table.find(digest);
+        }
+        catch (const std::invalid_argument&)
+        {
+            std::cout << digest << ": invalid digest" << std::endl;
+            ++invalid;
+            continue;
+        }
+        auto end_time = std::chrono::steady_clock::now();
+        double us = std::chrono::duration<double, std::micro>(end_time - start_time).count();
+
+        if (plaintext)
+        {
+            std::cout << digest << ":" << *plaintext << " (" << us << " us)" << std::endl;
+            ++found;
+        }
+        else
+            std::cout << digest << " not in table (" << us << " us)" << std::endl;
+    }
+    if (invalid != 0)
+        return 2;
+    return found == digests.size() ? 0 : 1;
+}
+
+// Hands the keyspace out in leases to "work" nodes that connect to --listen
+static int runCoordinator(const Cli::Options& options)
+{
+    Cluster::CoordinatorConfig config;
+    readJob(options, config.job);
+
+    // Nodes only learn the keyspace and the target keys, so salted and iterated
+    // jobs would silently be swept as plain MD5
+    bool salted = !config.job.salts.empty() || options.has("salted") || options.has("iterations");
+    if (!salted && !config.job.targets_file.empty())
+    {
+        std::ifstream file(config.job.targets_file);
+        size_t hex = Hashing::hexLength(config.job.algorithm);
+        std::string line;
+        while (!salted && std::getline(file, line))
+            salted = line.size() > hex && line[hex] == ':';
+    }
+    if (salted)
+        throw std::invalid_argument("Coordinated jobs only support unsalted targets; use crack for salted and iterated modes.");
+
+    config.address = options.get("listen");
+    if (config.address.empty())
+        throw std::invalid_argument("Option --listen is required, e.g. tcp:0.0.0.0:7000 or unix:/tmp/cracker.sock.");
+    config.lease_size = options.getSize("lease", static_cast<size_t>(config.lease_size));
+    config.node_timeout = std::chrono::milliseconds(options.getSize("node-timeout", 15) * 1000);
+    config.verbose = !options.has("quiet");
+
+    Cluster::Coordinator coordinator(std::move(config));
+    std::cout << "Loaded " << coordinator.job().targetCount() << " target digests." << std::endl;
+    Cluster::ClusterResult result = coordinator.run();
+
+    for (const Cracking::Match& match : result.matches)
+    {
+        std::cout << coordinator.job().digestOf(match) << ":" << coordinator.job().keyOf(match)
+                  << " (index " << Generators::toDecimal(match.index) << ", after " << match.elapsed_ns / 1e6 << " ms)" << std::endl;
+    }
+
+    if (result.matches.empty())
+        std::cout << "No match found in " << Generators::toDecimal(result.total) << " candidates." << std::endl;
+    std::cout << "Job finished in " << result.elapsed_ms << " ms" << std::endl;
+    std::cout << "Hashed " << result.processed() << " candidates at " << result.rate() / 1e6
+              << " MH/s" << std::endl;
+
+    for (const Cluster::NodeStats& node : result.nodes)
+    {
+        std::cout << "Node " << node.name << ": " << node.leases << " leases, " << node.processed << " candidates, "
+                  << node.rate() / 1e6 << " MH/s" << (node.lost != 0 ? ", " + std::to_string(node.lost) + " leases lost" : "") << std::endl;
+    }
+
+    return result.matches.empty() ? 1 : 0;
+}
+
+// Times short sweeps of the job's keyspace to find the fastest worker count,
+// chunk size and SIMD width on this host, and saves them for later runs
+static int runAutotune(const Cli::Options& options)
+{
+    Cracking::CrackConfig job;
+    readJob(options, job);
+    if (!job.targets.empty() || !job.targets_file.empty())
+        throw std::invalid_argument("Autotuning sweeps without targets.");
+    std::string backend = options.get("backend", "fork");
+    if (backend == "thread")
+        job.workers.backend = LoadBalancing::Backend::Thread;
+    else if (backend != "fork")
+        throw std::invalid_argument("Unknown backend '" + backend + "', expected 'fork' or 'thread'.");
+    job.workers.pin = options.has("pin");
+    std::chrono::milliseconds trial(options.getSize("trial-ms", 150));
+    int repeats = options.getInt("repeats", 5);
+
+    auto report = [](const Tuning::Trial& trial)
+    {
+        std::cout << "  " << trial.workers << " workers, chunk " << trial.chunk << ", "
+                  << Hashing::Md5Batch::isaName(trial.isa) << ": " << trial.rate / 1e6 << " MH/s (spread "
+                  << trial.spread / 1e6 << ")" << std::endl;
+    };
+    Tuning::Profile profile = Tuning::Autotuner(job, trial, repeats, report).tune();
+
+    std::string path = options.get("profile", Tuning::defaultProfilePath(job.algorithm));
+    profile.save(path);
+    std::cout << "Best: " << profile.workers << " workers, chunk " << profile.chunk << ", "
+              << Hashing::Md5Batch::isaName(profile.isa) << " at " << profile.rate / 1e6 << " MH/s; saved to '" << path
+              << "'" << std::endl;
+    return 0;
+}
+
+// Sweeps leases from the coordinator at --connect with this machine's workers
+static int runNode(const Cli::Options& options)
+{
+    Cluster::NodeConfig config;
+    readWorkers(options, config.local);
+    config.configure = [&options](Cracking::CrackConfig& job) { applyProfile(options, job); };
+    config.local.progress = options.has("progress");
+    config.address = options.get("connect");
+    if (config.address.empty())
+        throw std::invalid_argument("Option --connect is required, e.g. tcp:127.0.0.1:7000 or unix:/tmp/cracker.sock.");
+    config.name = options.get("name");
+
+    Cluster::NodeResult result = Cluster::Node(std::move(config)).run();
+    std::cout << "Swept " << result.leases << " leases, " << result.processed << " candidates, "
+              << result.matches << " matches." << std::endl;
+    return 0;
+}
+
+// Job handed to the benchmark worker pool; the charset is fixed before the fork
+struct BenchmarkJob
+{
+    size_t size;
+};
+
+// Times every size on one persistent pool per fork count, so the fork cost is
+// paid (and reported) once per pool instead of being part of every measurement
+static void runPoolBenchmark(std::map<size_t, Results::ResultsTable>& tables, const std::string& charset,
+                             size_t max_size, int max_num_forks)
+{
+    for (int num_forks = 1; num_forks <= max_num_forks; num_forks++)
+    {
+        try
+        {
+            LoadBalancing::WorkerPool<BenchmarkJob> pool(num_forks, [&charset](int, const BenchmarkJob& job, LoadBalancing::Range chunk)
+                                                         {
+                Generators::StringGenerator generator(job.size, charset, chunk.begin, chunk.size());
+                std::string s(job.size, '\0');
+                while (generator.next(s.data()))
+                {
+                } });
+
+            std::cout << "### Forks: " << num_forks << " Spawned in " << pool.spawnMs() << " ms" << std::endl;
+
+            for (size_t size = 1; size <= max_size; size++)
+            {
+                size_t total = static_cast<size_t>(Generators::StringGenerator::totalCombinations(size, charset));
+                double duration = pool.run({size}, total);
+                tables[size][num_forks] = duration;
+
+                std::cout << "Size " << size << " (" << total << " combinations) completed in " << duration << " ms" << std::endl;
+            }
+        }
+        catch (const std::exception &ex)
+        {
+            std::cerr << "Error: " << ex.what() << std::endl;
+        }
+    }
+}
+
+// Forks a fresh LoadBalancer for every (size, num_forks) pair; the measured time
+// includes spawning and reaping the children. With counters, the workers' hardware
+// events are summed per pair as well.
+static void runForkBenchmark(std::map<size_t, Results::ResultsTable>& tables, std::map<size_t, Results::CountersTable>* counters,
+                             const std::string& charset, size_t max_size, int max_num_forks)
 {
     Hashing::Md5 md5{};
-    size_t max_size = 5;
-    int max_num_forks = 80;
-    std::string charset = "abcdefghijklmnopqrstuvwxyz";
 
     for (size_t size = 1; size <= max_size; size++)
     {
-        size_t total = Generators::StringGenerator::totalCombinations(size, charset);
-        Results::ResultsTable table{};
-        
+        size_t total = static_cast<size_t>(Generators::StringGenerator::totalCombinations(size, charset));
+        Results::ResultsTable& table = tables[size];
+
         std::cout << "### Size: " << size << " Total number of combinations: " << total << std::endl;
 
         for (int num_forks = 1; num_forks <= max_num_forks; num_forks++)
         {
             try
             {
+                std::optional<Profiling::PerfCounters> perf;
+                LoadBalancing::WorkerOptions workers;
+                if (counters != nullptr)
+                {
+                    perf.emplace(num_forks);
+                    workers.counters = &*perf;
+                }
+
                 auto start_time = std::chrono::high_resolution_clock::now();
 
                 {
                     LoadBalancing::LoadBalancer lb(num_forks, [&md5, size, &charset, num_forks, total, max_num_forks](int fork_id)
                                                    {
-                        pid_t pid = getpid();
                         size_t start_idx = (total / num_forks) * fork_id;
                         size_t end_idx = (fork_id + 1 == num_forks) ? total - 1 : start_idx + (total / num_forks) - 1;
                         
-                        Generators::StringGenerator generator(
-                            size, charset,
-                            Generators::StringGenerator::numberToString(size, start_idx, charset),
-                            Generators::StringGenerator::numberToString(size, end_idx, charset));
+                        Generators::StringGenerator generator(size, charset, start_idx, end_idx - start_idx + 1);
 
-                        std::cout << "Child process PID:" << pid << " started working at index " << start_idx << std::endl;
-
-                        while (generator.hasNext())
+                        std::string s(size, '\0');
+                        while (generator.next(s.data()))
                         {
-                            std::string s = generator.next();
                             //std::cout << s << " " << md5.hash(s) << std::endl;
-                        }
-
-                        std::cout << "Child process PID: " << pid << " finished work at index " << end_idx << std::endl; });
+                        } }, workers);
 
                     // Fork child processes
                     lb.start();
@@ -63,16 +566,49 @@ int main()
                 table[num_forks] = duration.count();
 
                 std::cout << "All child processes have completed in " << duration.count() << " ms" << std::endl;
+                if (perf)
+                {
+                    Profiling::Counts events = perf->total();
+                    (*counters)[size][num_forks] = events;
+                    printCounters("Counters", events, total);
+                    if (num_forks == 1 && size == 1 && !perf->unavailableReason().empty())
+                        std::cout << "Some counters are unavailable: " << perf->unavailableReason() << std::endl;
+                }
             }
             catch (const std::exception &ex)
             {
                 std::cerr << "Error: " << ex.what() << std::endl;
             }
         }
+    }
+}
 
+// Times a full keyspace walk for every (size, num_forks) pair and plots the results
+static int runBenchmark(const Cli::Options& options)
+{
+    size_t max_size = options.getSize("max-size", 5);
+    int max_num_forks = options.getInt("max-forks", 80);
+    std::string charset = "abcdefghijklmnopqrstuvwxyz";
+    std::map<size_t, Results::ResultsTable> tables;
+    std::map<size_t, Results::CountersTable> counters;
+
+    if (options.has("pool") && options.has("perf"))
+        throw std::invalid_argument("Counters are only collected without --pool.");
+    if (options.has("pool"))
+        runPoolBenchmark(tables, charset, max_size, max_num_forks);
+    else
+        runForkBenchmark(tables, options.has("perf") ? &counters : nullptr, charset, max_size, max_num_forks);
+
+    for (const auto& [size, table] : tables)
+    {
         try
         {
             Results::ResultsWriter::writeResultsCsv(table, "data/" + std::to_string(size) + "znaky.csv");
+            if (counters.count(size) != 0)
+            {
+                uint64_t total = static_cast<uint64_t>(Generators::StringGenerator::totalCombinations(size, charset));
+                Results::ResultsWriter::writeCountersCsv(counters[size], total, "data/" + std::to_string(size) + "znaky_perf.csv");
+            }
         }
         catch (const std::runtime_error &e)
         {
@@ -102,4 +638,74 @@ int main()
     #endif
 
     return 0;
+}
+
+// Value options of the keyspace and targets (readJob), the local workers
+// (readWorkers) and the tuned profile (applyProfile)
+static const std::set<std::string> JobOptionNames{"size", "max-size", "min-size", "charset", "mask", "targets", "hash", "order", "seed", "shard"};
+static const std::set<std::string> WorkerOptionNames{"forks", "isa", "engine", "schedule", "chunk", "backend", "profile"};
+
+static std::set<std::string> join(std::initializer_list<std::set<std::string>> sets)
+{
+    std::set<std::string> names;
+    for (const std::set<std::string>& set : sets)
+        names.insert(set.begin(), set.end());
+    return names;
+}
+
+int main(int argc, char** argv)
+{
+    std::string mode = argc > 1 ? argv[1] : "";
+
+    try
+    {
+        if (mode == "crack")
+            return runCrack(Cli::Options(argc - 2, argv + 2, {"pin", "numa", "progress", "quiet", "stats", "perf", "no-profile"},
+                                         join({JobOptionNames, WorkerOptionNames, {"wordlist", "rules", "salted", "iterations", "resume", "checkpoint", "checkpoint-interval"}})));
+        if (mode == "coordinate")
+            return runCoordinator(Cli::Options(argc - 2, argv + 2, {"quiet"},
+                                               join({JobOptionNames, {"listen", "lease", "node-timeout", "salted", "iterations"}})));
+        if (mode == "dump")
+            return runDump(Cli::Options(argc - 2, argv + 2, {"pin", "numa", "progress", "quiet", "no-profile"},
+                                        join({JobOptionNames, WorkerOptionNames, {"wordlist", "rules", "output", "format", "iterations"}})));
+        if (mode == "table")
+            return runTable(Cli::Options(argc - 2, argv + 2, {"pin", "numa", "progress", "quiet", "no-profile"},
+                                         join({JobOptionNames, WorkerOptionNames, {"output", "memory"}})));
+        if (mode == "lookup")
+            return runLookup(Cli::Options(argc - 2, argv + 2, {}, {"table", "targets"}));
+        if (mode == "work")
+            return runNode(Cli::Options(argc - 2, argv + 2, {"pin", "numa", "progress", "no-profile"},
+                                        join({WorkerOptionNames, {"connect", "name"}})));
+        if (mode == "autotune")
+            return runAutotune(Cli::Options(argc - 2, argv + 2, {"pin"},
+                                            join({JobOptionNames, {"backend", "trial-ms", "repeats", "profile"}})));
+        if (mode.empty())
+            return runBenchmark(Cli::Options(0, nullptr));
+        if (mode == "benchmark")
+            return runBenchmark(Cli::Options(argc - 2, argv + 2, {"pool", "perf"}, {"max-size", "max-forks"}));
+    }
+    catch (const std::exception &ex)
+    {
+        std::cerr << "Error: " << ex.what() << std::endl;
+        return 2;
+    }
+
+    std::cerr << "Usage: " << argv[0] << " [benchmark [--pool | --perf] [--max-size N] [--max-forks N]]" << std::endl
+              << "       " << argv[0] << " crack [--size N | --min-size N --max-size N] [--hash md5|sha1|sha256|ntlm] [--charset CHARS] [--mask MASK] [--forks N] [--targets FILE] [--engine batch|incremental]" << std::endl
+              << "             [--schedule static|dynamic] [--chunk N] [--backend fork|thread] [--pin] [--numa]" << std::endl
+              << "             [--progress|--quiet] [--stats] [--perf] [--checkpoint FILE] [--checkpoint-interval SECONDS]" << std::endl
+              << "             [--resume FILE] [--shard K/N] [--wordlist FILE [--rules FILE]] [--isa scalar|sse2|avx2|avx512] [--profile FILE | --no-profile]" << std::endl
+              << "             [--salted before|after | --iterations N] [--order linear|strided|random [--seed N]] [<hex>[:salt]...]" << std::endl
+              << "       " << argv[0] << " dump --output FILE [--format text|binary] [--size N | --min-size N --max-size N | --mask MASK | --wordlist FILE [--rules FILE]]" << std::endl
+              << "             [--hash md5|sha1|sha256|ntlm | --iterations N] [--charset CHARS] [--forks N] [--backend fork|thread] [--shard K/N]" << std::endl
+              << "       " << argv[0] << " table --output FILE [--size N | --min-size N --max-size N | --mask MASK] [--charset CHARS] [--hash md5|sha1|sha256|ntlm]" << std::endl
+              << "             [--forks N] [--backend fork|thread] [--memory MiB]" << std::endl
+              << "       " << argv[0] << " lookup --table FILE [--targets FILE] [<hex>...]" << std::endl
+              << "       " << argv[0] << " coordinate --listen tcp:HOST:PORT|unix:PATH [--size N | --min-size N --max-size N] [--hash md5|sha1|sha256|ntlm] [--charset CHARS] [--mask MASK]" << std::endl
+              << "             [--targets FILE] [--shard K/N] [--order linear|strided|random [--seed N]] [--lease N] [--node-timeout SECONDS] [--quiet] [<md5 hex>...]" << std::endl
+              << "       " << argv[0] << " work --connect tcp:HOST:PORT|unix:PATH [--name NAME] [--forks N] [--engine batch|incremental]" << std::endl
+              << "             [--chunk N] [--backend fork|thread] [--pin] [--numa] [--progress]" << std::endl
+              << "       " << argv[0] << " autotune [--size N | --min-size N --max-size N | --mask MASK] [--charset CHARS] [--hash md5|sha1|sha256|ntlm]" << std::endl
+              << "             [--backend fork|thread] [--pin] [--trial-ms N] [--repeats N] [--profile FILE]" << std::endl;
+    return 2;
 }
\ No newline at end of file
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <string_view>
+#include <stdexcept>
+#include <utility>
+
+namespace Storage
+{
+    // Read-only view of a whole file. Mapped MAP_PRIVATE before fork(), the page
+    // cache copy is shared by every child instead of being read per process.
+    class MappedFile
+    {
+    public:
+        explicit MappedFile(const std::string& path)
+        {
+            int fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                throw std::runtime_error("Unable to open file '" + path + "': " + strerror(errno));
+
+            struct stat info;
+            if (fstat(fd, &info) != 0)
+            {
+                close(fd);
+                throw std::runtime_error("Unable to stat file '" + path + "': " + strerror(errno));
+            }
+
+            size_ = static_cast<size_t>(info.st_size);
+            if (size_ > 0)
+            {
+                void* memory = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (memory == MAP_FAILED)
+                {
+                    close(fd);
+                    throw std::runtime_error("Unable to map file '" + path + "': " + strerror(errno));
+                }
+                data_ = static_cast<const char*>(memory);
+                madvise(memory, size_, MADV_SEQUENTIAL);
+            }
+            close(fd);
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        MappedFile(MappedFile&& other) noexcept
+            : data_(std::exchange(other.data_, nullptr)), size_(std::exchange(other.size_, 0))
+        {
+        }
+
+        ~MappedFile()
+        {
+            if (data_ != nullptr)
+                munmap(const_cast<char*>(data_), size_);
+        }
+
+        std::string_view view() const
+        {
+            return std::string_view(data_ == nullptr ? "" : data_, size_);
+        }
+
+        const char* data() const
+        {
+            return data_;
+        }
+
+        size_t size() const
+        {
+            return size_;
+        }
+
+    private:
+        const char* data_ = nullptr;
+        size_t size_ = 0;
+    };
+
+    // Zero-filled anonymous MAP_PRIVATE region. Built by the parent and only read
+    // by the children, its pages stay shared copy-on-write after fork().
+    class MappedRegion
+    {
+    public:
+        MappedRegion() = default;
+
+        explicit MappedRegion(size_t bytes)
+            : size_(bytes)
+        {
+            if (size_ == 0)
+                return;
+
+            void* memory = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (memory == MAP_FAILED)
+                throw std::runtime_error(std::string("Memory mapping failed: ") + strerror(errno));
+            data_ = memory;
+        }
+
+        MappedRegion(const MappedRegion&) = delete;
+        MappedRegion& operator=(const MappedRegion&) = delete;
+
+        MappedRegion(MappedRegion&& other) noexcept
+            : data_(std::exchange(other.data_, nullptr)), size_(std::exchange(other.size_, 0))
+        {
+        }
+
+        MappedRegion& operator=(MappedRegion&& other) noexcept
+        {
+            if (this != &other)
+            {
+                release();
+                data_ = std::exchange(other.data_, nullptr);
+                size_ = std::exchange(other.size_, 0);
+            }
+            return *this;
+        }
+
+        ~MappedRegion()
+        {
+            release();
+        }
+
+        template <typename T>
+        T* as() const
+        {
+            return static_cast<T*>(data_);
+        }
+
+        size_t size() const
+        {
+            return size_;
+        }
+
+    private:
+        void* data_ = nullptr;
+        size_t size_ = 0;
+
+        void release()
+        {
+            if (data_ != nullptr)
+                munmap(data_, size_);
+            data_ = nullptr;
+            size_ = 0;
+        }
+    };
+}
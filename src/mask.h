@@ -0,0 +1,192 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+#include "index.h"
+
+namespace Generators
+{
+    // Fixed-length keyspace with its own charset at every position, enumerated as
+    // a mixed-radix number with the last position varying fastest.
+    //
+    // Masks use the hashcat placeholders ?l (a-z), ?u (A-Z), ?d (0-9),
+    // ?s (printable symbols and space), ?a (all of them) and ?? for a literal '?';
+    // any other character stands for itself. "?u?l?l?d?d" has 26*26*26*10*10
+    // candidates instead of 62^5 for the same length over ?a.
+    class Mask
+    {
+    public:
+        static constexpr const char* Lower = "abcdefghijklmnopqrstuvwxyz";
+        static constexpr const char* Upper = "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+        static constexpr const char* Digits = "0123456789";
+        static constexpr const char* Symbols = " !\"#$%&'()*+,-./:;<=>?@[\\]^_`{|}~";
+
+        // The same charset at each of size positions
+        Mask(size_t size, const std::string& charset)
+        {
+            if (size == 0)
+                throw std::invalid_argument("String size must be at least 1.");
+            if (charset.empty())
+                throw std::invalid_argument("Character set must contain at least one character.");
+
+            charsets_.assign(size, normalize(charset));
+        }
+
+        static Mask parse(const std::string& pattern)
+        {
+            std::vector<std::string> charsets;
+            for (size_t i = 0; i < pattern.size(); ++i)
+            {
+                if (pattern[i] != '?')
+                {
+                    charsets.push_back(std::string(1, pattern[i]));
+                    continue;
+                }
+
+                if (++i == pattern.size())
+                    throw std::invalid_argument("Mask '" + pattern + "' ends with an incomplete placeholder.");
+
+                switch (pattern[i])
+                {
+                case 'l':
+                    charsets.push_back(Lower);
+                    break;
+                case 'u':
+                    charsets.push_back(Upper);
+                    break;
+                case 'd':
+                    charsets.push_back(Digits);
+                    break;
+                case 's':
+                    charsets.push_back(Symbols);
+                    break;
+                case 'a':
+                    charsets.push_back(std::string(Lower) + Upper + Digits + Symbols);
+                    break;
+                case '?':
+                    charsets.push_back("?");
+                    break;
+                default:
+                    throw std::invalid_argument(std::string("Unknown mask placeholder '?") + pattern[i] + "'.");
+                }
+            }
+
+            if (charsets.empty())
+                throw std::invalid_argument("Mask must describe at least one position.");
+
+            Mask mask;
+            for (const std::string& charset : charsets)
+                mask.charsets_.push_back(normalize(charset));
+            mask.pattern_ = pattern;
+            return mask;
+        }
+
+        size_t size() const
+        {
+            return charsets_.size();
+        }
+
+        // Sorted, de-duplicated charset of one position
+        const std::string& charset(size_t position) const
+        {
+            return charsets_[position];
+        }
+
+        // Pattern the mask was parsed from; empty for a single-charset mask
+        const std::string& pattern() const
+        {
+            return pattern_;
+        }
+
+        // Mask of the first size positions, e.g. "?u?l" for "?u?l?d" and size 2
+        Mask prefix(size_t size) const
+        {
+            if (size == 0 || size > charsets_.size())
+                throw std::out_of_range("Mask prefix must be between 1 and the mask size.");
+
+            Mask mask;
+            mask.charsets_.assign(charsets_.begin(), charsets_.begin() + size);
+            if (!pattern_.empty())
+            {
+                size_t end = 0;
+                for (size_t position = 0; position < size; ++position)
+                    end += pattern_[end] == '?' ? 2 : 1;
+                mask.pattern_ = pattern_.substr(0, end);
+            }
+            return mask;
+        }
+
+        // Number of candidates: the product of the charset sizes
+        Index total() const
+        {
+            Index total = 1;
+            for (const std::string& charset : charsets_)
+            {
+                // Check for potential overflow
+                if (total > MaxIndex / charset.size())
+                    throw std::overflow_error("Total number of combinations exceeds 128 bits.");
+                total *= charset.size();
+            }
+            return total;
+        }
+
+        // Candidate at a position in the series
+        std::string toString(Index index) const
+        {
+            if (index >= total())
+                throw std::out_of_range("Position is out of the valid range for the given size and charset.");
+
+            std::string result(charsets_.size(), '\0');
+            for (size_t i = charsets_.size(); i-- > 0;)
+            {
+                const std::string& charset = charsets_[i];
+                result[i] = charset[index % charset.size()];
+                index /= charset.size();
+            }
+            return result;
+        }
+
+        bool contains(const std::string& str) const
+        {
+            if (str.size() != charsets_.size())
+                return false;
+            for (size_t i = 0; i < str.size(); ++i)
+            {
+                if (!std::binary_search(charsets_[i].begin(), charsets_[i].end(), str[i]))
+                    return false;
+            }
+            return true;
+        }
+
+        // Position of a candidate in the series
+        Index toIndex(const std::string& str) const
+        {
+            if (!contains(str))
+                throw std::invalid_argument("String contains characters not in the character set.");
+
+            Index index = 0;
+            for (size_t i = 0; i < str.size(); ++i)
+            {
+                const std::string& charset = charsets_[i];
+                index = index * charset.size() + static_cast<size_t>(std::lower_bound(charset.begin(), charset.end(), str[i]) - charset.begin());
+            }
+            return index;
+        }
+
+    private:
+        std::vector<std::string> charsets_;
+        std::string pattern_;
+
+        Mask() = default;
+
+        static std::string normalize(std::string charset)
+        {
+            std::sort(charset.begin(), charset.end());
+            charset.erase(std::unique(charset.begin(), charset.end()), charset.end());
+            return charset;
+        }
+    };
+}
@@ -0,0 +1,321 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+
+#include "hasher.h"
+
+namespace Hashing
+{
+    // Instruction sets the batch engine can run on, narrowest first
+    enum class Isa
+    {
+        Scalar,
+        Sse2,
+        Avx2,
+        Avx512
+    };
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HASHING_X86 1
+    typedef uint32_t Lanes4 __attribute__((vector_size(16)));
+    typedef uint32_t Lanes8 __attribute__((vector_size(32)));
+    typedef uint32_t Lanes16 __attribute__((vector_size(64)));
+#else
+#define HASHING_X86 0
+#endif
+
+    // Multi-buffer MD5: hashes 4/8/16 independent single-block messages at once,
+    // one message per SIMD lane. The widest instruction set supported by the CPU
+    // is picked at runtime, with a plain scalar loop as the fallback.
+    class Md5Batch : public IHasher
+    {
+    public:
+        static constexpr size_t MaxLanes = 16;
+        static constexpr size_t MaxMessageSize = Md5::MaxSingleBlockSize;
+
+        // Same static surface as BatchHasher (batch_hasher.h), so the sweeps can
+        // be written once for every algorithm
+        typedef Md5Digest Digest;
+        static constexpr const char* Name = "MD5";
+        static constexpr size_t DigestSize = 16;
+
+        explicit Md5Batch(Isa isa = detectIsa())
+            : isa_(isa), lanes_(laneCount(isa))
+        {
+            if (!isSupported(isa_))
+                throw std::invalid_argument(std::string("Instruction set not supported by this CPU: ") + isaName(isa_));
+        }
+
+        Isa isa() const
+        {
+            return isa_;
+        }
+
+        // Number of messages hashed by one kernel invocation
+        size_t lanes() const
+        {
+            return lanes_;
+        }
+
+        std::string hash(const std::string& msg) const override
+        {
+            Md5Digest digest;
+            std::string_view view = msg;
+            hashBatch(&view, 1, &digest);
+            return Md5::toHex(digest);
+        }
+
+        // Hashes count messages into out[0..count). Messages longer than
+        // MaxMessageSize are handed to the scalar Md5 implementation.
+        void hashBatch(const std::string_view* msgs, size_t count, Md5Digest* out) const
+        {
+            alignas(64) uint32_t words[16 * MaxLanes];
+            Md5Digest digests[MaxLanes];
+            size_t slot_of[MaxLanes];
+
+            size_t i = 0;
+            while (i < count)
+            {
+                // Gather up to lanes_ short messages into one word-major block
+                std::memset(words, 0, sizeof(words));
+                size_t used = 0;
+                for (; i < count && used < lanes_; ++i)
+                {
+                    if (msgs[i].size() > MaxMessageSize)
+                    {
+                        out[i] = Md5::digest(msgs[i]);
+                        continue;
+                    }
+                    packMessage(msgs[i], words, MaxLanes, used);
+                    slot_of[used++] = i;
+                }
+
+                if (used == 0)
+                    continue;
+
+                hashBlock(words, MaxLanes, digests);
+                for (size_t lane = 0; lane < used; ++lane)
+                    out[slot_of[lane]] = digests[lane];
+            }
+        }
+
+        // Hashes one pre-padded block per lane. Word j of lane l is read from
+        // words[j * stride + l]; out receives lanes() digests.
+        void hashBlock(const uint32_t* words, size_t stride, Md5Digest* out) const
+        {
+            hashBlock(Md5::IV, words, stride, out);
+        }
+
+        // Same, but every lane continues from initial instead of the IV, e.g. the
+        // midstate of a salt prefix; the blocks then carry the total bit length
+        void hashBlock(const Md5Digest& initial, const uint32_t* words, size_t stride, Md5Digest* out) const
+        {
+            switch (isa_)
+            {
+#if HASHING_X86
+            case Isa::Avx512:
+                compressAvx512(initial, words, stride, out);
+                return;
+            case Isa::Avx2:
+                compressAvx2(initial, words, stride, out);
+                return;
+            case Isa::Sse2:
+                compressSse2(initial, words, stride, out);
+                return;
+#endif
+            default:
+                compressScalar(initial, words, stride, out);
+                return;
+            }
+        }
+
+        // Hashes count lanes of a word-major block wider than lanes(), e.g. a
+        // Generators::CandidateBlock, one kernel invocation per lanes() slice.
+        // stride must be a multiple of lanes().
+        void hashBlocks(const uint32_t* words, size_t stride, size_t count, Md5Digest* out) const
+        {
+            if (stride % lanes_ != 0)
+                throw std::invalid_argument("Block stride must be a multiple of the lane count.");
+
+            Md5Digest digests[MaxLanes];
+            for (size_t offset = 0; offset < count; offset += lanes_)
+            {
+                size_t n = std::min(lanes_, count - offset);
+                if (n == lanes_)
+                {
+                    hashBlock(words + offset, stride, out + offset);
+                    continue;
+                }
+
+                // Partial tail: the kernel always fills lanes() digests
+                hashBlock(words + offset, stride, digests);
+                std::copy(digests, digests + n, out + offset);
+            }
+        }
+
+        static Md5Digest digest(std::string_view msg)
+        {
+            return Md5::digest(msg);
+        }
+
+        static std::array<uint8_t, DigestSize> toBytes(const Md5Digest& digest)
+        {
+            return Md5::toBytes(digest);
+        }
+
+        static std::string toHex(const Md5Digest& digest)
+        {
+            return Md5::toHex(digest);
+        }
+
+        static Md5Digest fromHex(std::string_view hex)
+        {
+            return Md5::fromHex(hex);
+        }
+
+        // The digest is its own target table key
+        static Md5Digest key(const Md5Digest& digest)
+        {
+            return digest;
+        }
+
+        // Writes msg, the 0x80 terminator and the bit length into lane of a zeroed block
+        static void packMessage(std::string_view msg, uint32_t* words, size_t stride, size_t lane)
+        {
+            for (size_t i = 0; i < msg.size(); ++i)
+                words[(i / 4) * stride + lane] |= static_cast<uint32_t>(static_cast<uint8_t>(msg[i])) << ((i % 4) * 8);
+            words[(msg.size() / 4) * stride + lane] |= 0x80u << ((msg.size() % 4) * 8);
+            words[14 * stride + lane] = static_cast<uint32_t>(msg.size() * 8);
+        }
+
+        // Widest instruction set usable on this CPU
+        static Isa detectIsa()
+        {
+            for (Isa isa : {Isa::Avx512, Isa::Avx2, Isa::Sse2})
+            {
+                if (isSupported(isa))
+                    return isa;
+            }
+            return Isa::Scalar;
+        }
+
+        static bool isSupported(Isa isa)
+        {
+            switch (isa)
+            {
+#if HASHING_X86
+            case Isa::Avx512:
+                return __builtin_cpu_supports("avx512f");
+            case Isa::Avx2:
+                return __builtin_cpu_supports("avx2");
+            case Isa::Sse2:
+                return __builtin_cpu_supports("sse2");
+#endif
+            case Isa::Scalar:
+                return true;
+            default:
+                return false;
+            }
+        }
+
+        static size_t laneCount(Isa isa)
+        {
+            switch (isa)
+            {
+            case Isa::Avx512:
+                return 16;
+            case Isa::Avx2:
+                return 8;
+            case Isa::Sse2:
+                return 4;
+            default:
+                return 1;
+            }
+        }
+
+        static const char* isaName(Isa isa)
+        {
+            switch (isa)
+            {
+            case Isa::Avx512:
+                return "avx512";
+            case Isa::Avx2:
+                return "avx2";
+            case Isa::Sse2:
+                return "sse2";
+            default:
+                return "scalar";
+            }
+        }
+
+        static Isa parseIsa(const std::string& name)
+        {
+            for (Isa isa : {Isa::Scalar, Isa::Sse2, Isa::Avx2, Isa::Avx512})
+            {
+                if (name == isaName(isa))
+                    return isa;
+            }
+            throw std::invalid_argument("Unknown instruction set '" + name + "', expected scalar, sse2, avx2 or avx512.");
+        }
+
+    private:
+        Isa isa_;
+        size_t lanes_;
+
+        // Loads the block, runs the shared MD5 rounds on all lanes and splits the
+        // resulting state vectors back into per-message digests
+        template <typename V>
+        [[gnu::always_inline]] static inline void compressLanes(const Md5Digest& initial, const uint32_t* words, size_t stride, Md5Digest* out)
+        {
+            constexpr size_t lanes = sizeof(V) / sizeof(uint32_t);
+
+            V M[16];
+            for (size_t j = 0; j < 16; ++j)
+                std::memcpy(&M[j], words + j * stride, sizeof(V));
+
+            V state[4];
+            for (size_t k = 0; k < 4; ++k)
+                state[k] = V{} + initial[k];
+
+            Md5::compress(state, M);
+
+            for (size_t lane = 0; lane < lanes; ++lane)
+            {
+                for (size_t k = 0; k < 4; ++k)
+                    out[lane][k] = state[k][lane];
+            }
+        }
+
+        static void compressScalar(const Md5Digest& initial, const uint32_t* words, size_t stride, Md5Digest* out)
+        {
+            uint32_t M[16];
+            for (size_t j = 0; j < 16; ++j)
+                M[j] = words[j * stride];
+
+            out[0] = initial;
+            Md5::compress(out[0].data(), M);
+        }
+
+#if HASHING_X86
+        [[gnu::target("sse2")]] static void compressSse2(const Md5Digest& initial, const uint32_t* words, size_t stride, Md5Digest* out)
+        {
+            compressLanes<Lanes4>(initial, words, stride, out);
+        }
+
+        [[gnu::target("avx2")]] static void compressAvx2(const Md5Digest& initial, const uint32_t* words, size_t stride, Md5Digest* out)
+        {
+            compressLanes<Lanes8>(initial, words, stride, out);
+        }
+
+        [[gnu::target("avx512f")]] static void compressAvx512(const Md5Digest& initial, const uint32_t* words, size_t stride, Md5Digest* out)
+        {
+            compressLanes<Lanes16>(initial, words, stride, out);
+        }
+#endif
+    };
+}
@@ -0,0 +1,426 @@
+#pragma once
+#include <string>
+#include <algorithm>
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "hasher.h"
+#include "md5_batch.h"
+
+namespace Hashing
+{
+    // MD5 engine for keyspace sweeps where consecutive candidates differ only in
+    // their last few bytes.
+    //
+    // For a fixed message length every message word except the one holding the
+    // last character (the "varying word") stays constant across a run of
+    // candidates. setPrefix() folds those constant words into K[i] + M[g] once and
+    // precomputes the leading round 1 steps that never read the varying word, so
+    // each lane only runs the remaining steps on a single patched word.
+    //
+    // When the varying word takes few values (e.g. one character of a-z), runs of
+    // a prefix are too short to fill the lanes and setPrefix() runs too often. With
+    // two varying words the word before it is patched per lane as well (the
+    // "leading word"), at the cost of one more step per lane.
+    //
+    // With a handful of targets, setTargets() additionally runs the tail of round 4
+    // backwards from every target (those steps only read constant words). The
+    // candidates then stop at the last step that reads the varying word, and
+    // already drop out three steps earlier when the first finished register does
+    // not match. Lanes are spread over SSE2/AVX2/AVX-512 like Md5Batch.
+    class Md5Incremental
+    {
+    public:
+        static constexpr size_t MaxReversedTargets = 8;
+
+        explicit Md5Incremental(size_t length, Isa isa = Md5Batch::detectIsa(), size_t varying_words = 1)
+            : length_(length), isa_(isa), lanes_(Md5Batch::laneCount(isa))
+        {
+            if (length_ == 0 || length_ > Md5::MaxSingleBlockSize)
+                throw std::invalid_argument("Incremental MD5 supports message lengths from 1 to 55 bytes.");
+            if (!Md5Batch::isSupported(isa_))
+                throw std::invalid_argument(std::string("Instruction set not supported by this CPU: ") + Md5Batch::isaName(isa_));
+            if (varying_words < 1 || varying_words > 2 || (varying_words == 2 && length_ <= 4))
+                throw std::invalid_argument("Incremental MD5 varies one word, or two for messages longer than 4 bytes.");
+
+            prefix_.word = static_cast<int>((length_ - 1) / 4);
+            prefix_.wide = varying_words == 2;
+            // Round 1 reads the words in order, so the steps before the varying words are constant
+            prefix_.first_step = prefix_.word - (prefix_.wide ? 1 : 0);
+            prefix_.last_step = 63;
+            prefix_.check_step = -1;
+        }
+
+        size_t lanes() const
+        {
+            return lanes_;
+        }
+
+        Isa isa() const
+        {
+            return isa_;
+        }
+
+        // Index of the message word that carries the last character
+        size_t varyingWord() const
+        {
+            return static_cast<size_t>(prefix_.word);
+        }
+
+        // 1, or 2 when the leading word varies as well
+        size_t varyingWords() const
+        {
+            return prefix_.wide ? 2 : 1;
+        }
+
+        // Leading bytes that must not change between setPrefix() calls
+        size_t prefixSize() const
+        {
+            return static_cast<size_t>(prefix_.first_step) * 4;
+        }
+
+        bool reversing() const
+        {
+            return !targets_.empty();
+        }
+
+        // Value of the varying word for a candidate of length() bytes, including
+        // the 0x80 terminator when it falls into the same word
+        uint32_t varyingWordOf(const char* msg) const
+        {
+            uint32_t word = 0;
+            size_t begin = varyingWord() * 4;
+            for (size_t i = begin; i < length_; ++i)
+                word |= static_cast<uint32_t>(static_cast<uint8_t>(msg[i])) << ((i - begin) * 8);
+            if (length_ - begin < 4)
+                word |= 0x80u << ((length_ - begin) * 8);
+            return word;
+        }
+
+        // Value of the leading word for a candidate of a two-word engine; a
+        // one-word engine ignores it
+        uint32_t leadingWordOf(const char* msg) const
+        {
+            uint32_t word = 0;
+            std::memcpy(&word, msg + prefixSize(), std::min<size_t>(4, length_ - prefixSize()));
+            return word;
+        }
+
+        // Switches to early-exit matching against at most MaxReversedTargets digests
+        void setTargets(const std::vector<Md5Digest>& targets)
+        {
+            if (targets.size() > MaxReversedTargets)
+                throw std::invalid_argument("Too many targets for reversed matching.");
+
+            targets_ = targets;
+            prefix_.target_count = static_cast<int>(targets_.size());
+            prefix_.last_step = targets_.empty() ? 63 : lastUse(prefix_.word, prefix_.wide);
+            prefix_.check_step = targets_.empty() ? -1 : prefix_.last_step - 3;
+        }
+
+        // Precomputes everything that depends only on the constant words of msg
+        void setPrefix(const char* msg)
+        {
+            uint8_t block[64] = {};
+            std::memcpy(block, msg, length_);
+            block[length_] = 0x80;
+
+            uint32_t M[16];
+            std::memcpy(M, block, sizeof(M));
+            M[14] = static_cast<uint32_t>(length_ * 8);
+
+            for (int i = 0; i < 64; ++i)
+            {
+                int g = messageIndex(i);
+                bool varying = g == prefix_.word || (prefix_.wide && g == prefix_.word - 1);
+                prefix_.KM[i] = Md5::K[i] + (varying ? 0 : M[g]);
+            }
+
+            uint32_t R[4] = {Md5::IV[0], Md5::IV[1], Md5::IV[2], Md5::IV[3]};
+            for (int i = 0; i < prefix_.first_step; ++i)
+                forwardStep(R, i, prefix_.KM[i]);
+            std::memcpy(prefix_.state, R, sizeof(R));
+
+            for (size_t t = 0; t < targets_.size(); ++t)
+            {
+                for (int k = 0; k < 4; ++k)
+                    R[k] = targets_[t][k] - Md5::IV[k];
+                for (int i = 63; i > prefix_.last_step; --i)
+                    backwardStep(R, i, prefix_.KM[i]);
+                std::memcpy(prefix_.reversed[t], R, sizeof(R));
+            }
+        }
+
+        // Full digests of lanes() candidates given their varying words
+        void hashWords(const uint32_t* words, Md5Digest* out) const
+        {
+            dispatch(nullptr, words, out);
+        }
+
+        // Bit l is set when lane l hashes to one of the reversed targets
+        uint32_t matchWords(const uint32_t* words) const
+        {
+            return dispatch(nullptr, words, nullptr);
+        }
+
+        // The same for a two-word engine, with the leading words of the lanes
+        void hashWords(const uint32_t* leading, const uint32_t* words, Md5Digest* out) const
+        {
+            dispatch(leading, words, out);
+        }
+
+        uint32_t matchWords(const uint32_t* leading, const uint32_t* words) const
+        {
+            return dispatch(leading, words, nullptr);
+        }
+
+    private:
+        // Everything the lane kernels need, recomputed by setPrefix()
+        struct Prefix
+        {
+            uint32_t KM[64];
+            uint32_t state[4];
+            uint32_t reversed[MaxReversedTargets][4];
+            int word;
+            bool wide;
+            int first_step;
+            int last_step;
+            int check_step;
+            int target_count = 0;
+        };
+
+        size_t length_;
+        Isa isa_;
+        size_t lanes_;
+        Prefix prefix_;
+        std::vector<Md5Digest> targets_;
+
+        static constexpr int messageIndex(int i)
+        {
+            return i < 16 ? i : i < 32 ? (5 * i + 1) % 16 : i < 48 ? (3 * i + 5) % 16 : (7 * i) % 16;
+        }
+
+        // Last step of round 4 that reads message word w (or the word before it when wide)
+        static constexpr int lastUse(int w, bool wide = false)
+        {
+            for (int i = 63; i >= 48; --i)
+            {
+                if (messageIndex(i) == w || (wide && messageIndex(i) == w - 1))
+                    return i;
+            }
+            return 63;
+        }
+
+        static uint32_t roundFunction(int i, uint32_t B, uint32_t C, uint32_t D)
+        {
+            if (i < 16)
+                return D ^ (B & (C ^ D));
+            if (i < 32)
+                return C ^ (D & (B ^ C));
+            if (i < 48)
+                return B ^ C ^ D;
+            return C ^ (B | (~D));
+        }
+
+        // Scalar step i on registers that rotate roles the same way Md5::compress does
+        static void forwardStep(uint32_t* R, int i, uint32_t km)
+        {
+            int a = (4 - i % 4) % 4;
+            uint32_t& A = R[a];
+            uint32_t B = R[(a + 1) % 4], C = R[(a + 2) % 4], D = R[(a + 3) % 4];
+            uint32_t T = A + roundFunction(i, B, C, D) + km;
+            A = B + ((T << Md5::S[i]) | (T >> (32 - Md5::S[i])));
+        }
+
+        // Inverse of forwardStep: recovers the register overwritten by step i
+        static void backwardStep(uint32_t* R, int i, uint32_t km)
+        {
+            int a = (4 - i % 4) % 4;
+            uint32_t& A = R[a];
+            uint32_t B = R[(a + 1) % 4], C = R[(a + 2) % 4], D = R[(a + 3) % 4];
+            uint32_t T = A - B;
+            T = (T >> Md5::S[i]) | (T << (32 - Md5::S[i]));
+            A = T - roundFunction(i, B, C, D) - km;
+        }
+
+        uint32_t dispatch(const uint32_t* leading, const uint32_t* words, Md5Digest* out) const
+        {
+            switch (isa_)
+            {
+#if HASHING_X86
+            case Isa::Avx512:
+                return compressAvx512(prefix_, leading, words, out);
+            case Isa::Avx2:
+                return compressAvx2(prefix_, leading, words, out);
+            case Isa::Sse2:
+                return compressSse2(prefix_, leading, words, out);
+#endif
+            default:
+                return selectKernel<uint32_t>(prefix_, leading, words, out, std::make_index_sequence<14>{});
+            }
+        }
+
+        // Picks the kernel specialised for the current varying word and mode, so
+        // every skipped step and message index is resolved at compile time
+        template <typename V, size_t... W>
+        [[gnu::always_inline]] static inline uint32_t selectKernel(const Prefix& p, const uint32_t* leading, const uint32_t* words,
+                                                                   Md5Digest* out, std::index_sequence<W...>)
+        {
+            uint32_t result = 0;
+            (void)((p.word == static_cast<int>(W) && (result = selectMode<V, W>(p, leading, words, out), true)) || ...);
+            return result;
+        }
+
+        template <typename V, size_t W>
+        [[gnu::always_inline]] static inline uint32_t selectMode(const Prefix& p, const uint32_t* leading, const uint32_t* words, Md5Digest* out)
+        {
+            bool reverse = p.target_count > 0;
+            if constexpr (W > 0)
+            {
+                if (p.wide)
+                    return reverse ? compressLanes<V, W, true, true>(p, leading, words, out)
+                                   : compressLanes<V, W, false, true>(p, leading, words, out);
+            }
+            return reverse ? compressLanes<V, W, true, false>(p, leading, words, out)
+                           : compressLanes<V, W, false, false>(p, leading, words, out);
+        }
+
+        template <typename V>
+        [[gnu::always_inline]] static inline uint32_t laneMask(const V& value, uint32_t expected)
+        {
+            if constexpr (std::is_same_v<V, uint32_t>)
+            {
+                return value == expected ? 1u : 0u;
+            }
+            else
+            {
+                uint32_t mask = 0;
+                for (size_t lane = 0; lane < sizeof(V) / sizeof(uint32_t); ++lane)
+                    mask |= (value[lane] == expected ? 1u : 0u) << lane;
+                return mask;
+            }
+        }
+
+        template <int I, int W, bool Wide, int First, int Last, typename V>
+        [[gnu::always_inline]] static inline void step(V* R, const V& Ml, const V& Mw, const uint32_t* KM)
+        {
+            if constexpr (I >= First && I <= Last)
+            {
+                constexpr int a = (4 - I % 4) % 4;
+                constexpr int b = (a + 1) % 4;
+                constexpr int c = (a + 2) % 4;
+                constexpr int d = (a + 3) % 4;
+
+                V F;
+                if constexpr (I < 16)
+                    F = R[d] ^ (R[b] & (R[c] ^ R[d]));
+                else if constexpr (I < 32)
+                    F = R[c] ^ (R[d] & (R[b] ^ R[c]));
+                else if constexpr (I < 48)
+                    F = R[b] ^ R[c] ^ R[d];
+                else
+                    F = R[c] ^ (R[b] | (~R[d]));
+
+                V T = R[a] + F + KM[I];
+                if constexpr (messageIndex(I) == W)
+                    T += Mw;
+                if constexpr (Wide && messageIndex(I) == W - 1)
+                    T += Ml;
+                T = (T << Md5::S[I]) | (T >> (32 - Md5::S[I]));
+                R[a] = R[b] + T;
+            }
+        }
+
+        // Runs steps First..Last (inclusive)
+        template <int W, bool Wide, int First, int Last, typename V, size_t... I>
+        [[gnu::always_inline]] static inline void steps(std::index_sequence<I...>, V* R, const V& Ml, const V& Mw, const uint32_t* KM)
+        {
+            (step<I, W, Wide, First, Last>(R, Ml, Mw, KM), ...);
+        }
+
+        template <typename V, int W, bool Reverse, bool Wide>
+        [[gnu::always_inline]] static inline uint32_t compressLanes(const Prefix& p, const uint32_t* leading, const uint32_t* words, Md5Digest* out)
+        {
+            constexpr size_t lanes = sizeof(V) / sizeof(uint32_t);
+            constexpr int first_step = Wide ? W - 1 : W;
+            constexpr int last_step = Reverse ? lastUse(W, Wide) : 63;
+            // The register written three steps before the end is already final
+            constexpr int check_step = last_step - 3;
+            constexpr int checked = (4 - check_step % 4) % 4;
+
+            V Mw, Ml{};
+            std::memcpy(&Mw, words, sizeof(V));
+            if constexpr (Wide)
+                std::memcpy(&Ml, leading, sizeof(V));
+
+            V R[4];
+            for (size_t k = 0; k < 4; ++k)
+                R[k] = V{} + p.state[k];
+
+            if constexpr (!Reverse)
+            {
+                steps<W, Wide, first_step, 63>(std::make_index_sequence<64>{}, R, Ml, Mw, p.KM);
+                for (size_t k = 0; k < 4; ++k)
+                    R[k] += Md5::IV[k];
+
+                for (size_t lane = 0; lane < lanes; ++lane)
+                {
+                    for (size_t k = 0; k < 4; ++k)
+                    {
+                        if constexpr (std::is_same_v<V, uint32_t>)
+                            out[lane][k] = R[k];
+                        else
+                            out[lane][k] = R[k][lane];
+                    }
+                }
+                return (1u << lanes) - 1;
+            }
+            else
+            {
+                steps<W, Wide, first_step, check_step>(std::make_index_sequence<64>{}, R, Ml, Mw, p.KM);
+
+                // If no lane matches any target in the finished register, the
+                // remaining steps are not worth running
+                uint32_t mask = 0;
+                for (int t = 0; t < p.target_count; ++t)
+                    mask |= laneMask(R[checked], p.reversed[t][checked]);
+                if (mask == 0)
+                    return 0;
+
+                steps<W, Wide, check_step + 1, last_step>(std::make_index_sequence<64>{}, R, Ml, Mw, p.KM);
+
+                mask = 0;
+                for (int t = 0; t < p.target_count; ++t)
+                {
+                    uint32_t hit = ~0u;
+                    for (int k = 0; k < 4; ++k)
+                        hit &= laneMask(R[k], p.reversed[t][k]);
+                    mask |= hit;
+                }
+                return mask;
+            }
+        }
+
+#if HASHING_X86
+        [[gnu::target("sse2")]] static uint32_t compressSse2(const Prefix& p, const uint32_t* leading, const uint32_t* words, Md5Digest* out)
+        {
+            return selectKernel<Lanes4>(p, leading, words, out, std::make_index_sequence<14>{});
+        }
+
+        [[gnu::target("avx2")]] static uint32_t compressAvx2(const Prefix& p, const uint32_t* leading, const uint32_t* words, Md5Digest* out)
+        {
+            return selectKernel<Lanes8>(p, leading, words, out, std::make_index_sequence<14>{});
+        }
+
+        [[gnu::target("avx512f")]] static uint32_t compressAvx512(const Prefix& p, const uint32_t* leading, const uint32_t* words, Md5Digest* out)
+        {
+            return selectKernel<Lanes16>(p, leading, words, out, std::make_index_sequence<14>{});
+        }
+#endif
+    };
+}
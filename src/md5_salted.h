@@ -0,0 +1,144 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#include "hasher.h"
+#include "md5_batch.h"
+
+namespace Hashing
+{
+    // Where the salt goes relative to the password
+    enum class SaltPosition
+    {
+        Before, // md5(salt . pw)
+        After   // md5(pw . salt)
+    };
+
+    // md5(salt . pw) or md5(pw . salt) for one salt over batches of candidates.
+    //
+    // A salt in front has its whole 64-byte blocks compressed once into a
+    // midstate, so each candidate only costs the block holding the rest of the
+    // salt and the password. The two pieces are packed straight into the lanes
+    // and never concatenated; only messages longer than one block after the
+    // midstate go through the scalar path.
+    class Md5Salted
+    {
+    public:
+        Md5Salted(std::string salt, SaltPosition position)
+            : salt_(std::move(salt)), position_(position)
+        {
+            if (position_ == SaltPosition::Before)
+            {
+                for (; absorbed_ + 64 <= salt_.size(); absorbed_ += 64)
+                {
+                    uint32_t M[16] = {};
+                    for (size_t b = 0; b < 64; ++b)
+                        M[b / 4] |= static_cast<uint32_t>(static_cast<uint8_t>(salt_[absorbed_ + b])) << ((b % 4) * 8);
+                    Md5::compress(midstate_.data(), M);
+                }
+            }
+        }
+
+        const std::string& salt() const
+        {
+            return salt_;
+        }
+
+        // Hashes count passwords with the salt into out[0..count)
+        void hashBatch(const Md5Batch& md5, const std::string_view* msgs, size_t count, Md5Digest* out) const
+        {
+            alignas(64) uint32_t words[16 * Md5Batch::MaxLanes];
+            Md5Digest digests[Md5Batch::MaxLanes];
+            size_t slot_of[Md5Batch::MaxLanes];
+            std::string_view rest = std::string_view(salt_).substr(absorbed_);
+
+            size_t i = 0;
+            while (i < count)
+            {
+                std::memset(words, 0, sizeof(words));
+                size_t used = 0;
+                for (; i < count && used < md5.lanes(); ++i)
+                {
+                    std::string_view front = position_ == SaltPosition::Before ? rest : msgs[i];
+                    std::string_view back = position_ == SaltPosition::Before ? msgs[i] : rest;
+                    if (front.size() + back.size() > Md5::MaxSingleBlockSize)
+                    {
+                        out[i] = digest(msgs[i]);
+                        continue;
+                    }
+                    pack(front, back, words, Md5Batch::MaxLanes, used);
+                    slot_of[used++] = i;
+                }
+
+                if (used == 0)
+                    continue;
+
+                md5.hashBlock(midstate_, words, Md5Batch::MaxLanes, digests);
+                for (size_t lane = 0; lane < used; ++lane)
+                    out[slot_of[lane]] = digests[lane];
+            }
+        }
+
+        // Scalar digest of one salted password
+        Md5Digest digest(std::string_view pw) const
+        {
+            std::string_view rest = std::string_view(salt_).substr(absorbed_);
+            std::string message = position_ == SaltPosition::Before ? std::string(rest) + std::string(pw) : std::string(pw) + salt_;
+            return Md5::digest(message, midstate_, absorbed_);
+        }
+
+    private:
+        std::string salt_;
+        SaltPosition position_;
+        Md5Digest midstate_ = Md5::IV;
+        // Salt bytes already compressed into midstate_
+        size_t absorbed_ = 0;
+
+        // Writes front . back, the terminator and the total bit length into lane of a zeroed block
+        void pack(std::string_view front, std::string_view back, uint32_t* words, size_t stride, size_t lane) const
+        {
+            auto put = [&](std::string_view piece, size_t at)
+            {
+                for (size_t i = 0; i < piece.size(); ++i, ++at)
+                    words[(at / 4) * stride + lane] |= static_cast<uint32_t>(static_cast<uint8_t>(piece[i])) << ((at % 4) * 8);
+            };
+            put(front, 0);
+            put(back, front.size());
+
+            size_t size = front.size() + back.size();
+            uint64_t bits = static_cast<uint64_t>(absorbed_ + size) * 8;
+            words[(size / 4) * stride + lane] |= 0x80u << ((size % 4) * 8);
+            words[14 * stride + lane] = static_cast<uint32_t>(bits);
+            words[15 * stride + lane] = static_cast<uint32_t>(bits >> 32);
+        }
+    };
+
+    // Replaces each of count digests by the MD5 of its lowercase hex form, rounds
+    // times over, so md5(md5(pw)) is one batch hash plus rehashHex(..., 1)
+    inline void rehashHex(const Md5Batch& md5, Md5Digest* digests, size_t count, size_t rounds)
+    {
+        alignas(64) uint32_t words[16 * Md5Batch::MaxLanes];
+        Md5Digest hashed[Md5Batch::MaxLanes];
+        char hex[32];
+
+        for (size_t round = 0; round < rounds; ++round)
+        {
+            for (size_t offset = 0; offset < count; offset += md5.lanes())
+            {
+                size_t n = std::min(md5.lanes(), count - offset);
+                std::memset(words, 0, sizeof(words));
+                for (size_t lane = 0; lane < n; ++lane)
+                {
+                    Md5::toHex(digests[offset + lane], hex);
+                    Md5Batch::packMessage(std::string_view(hex, sizeof(hex)), words, Md5Batch::MaxLanes, lane);
+                }
+
+                md5.hashBlock(words, Md5Batch::MaxLanes, hashed);
+                std::copy(hashed, hashed + n, digests + offset);
+            }
+        }
+    }
+}
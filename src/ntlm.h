@@ -0,0 +1,66 @@
+#pragma once
+#include <array>
+#include <cstdint>
+
+#include "batch_hasher.h"
+
+namespace Hashing
+{
+    typedef std::array<uint32_t, 4> NtlmDigest;
+
+    // NTLM: MD4 (RFC 1320) over the UTF-16LE form of the password. Candidates
+    // are bytes, so every character is widened with a zero high byte.
+    class Ntlm : public BatchHasher<Ntlm, 4>
+    {
+    public:
+        using BatchHasher::BatchHasher;
+
+        static constexpr const char* Name = "NTLM";
+        static constexpr bool BigEndian = false;
+        static constexpr bool Utf16 = true;
+        static constexpr std::array<uint32_t, 4> IV = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476};
+
+        // The three MD4 rounds; in step i the register being updated rotates A, D, C, B
+        template <typename V>
+        [[gnu::always_inline]] static inline void compress(V* state, const V* M)
+        {
+            static constexpr int Order[3][16] = {
+                {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+                {0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15},
+                {0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15}};
+            static constexpr int Shift[3][4] = {{3, 7, 11, 19}, {3, 5, 9, 13}, {3, 9, 11, 15}};
+            static constexpr uint32_t Constant[3] = {0, 0x5a827999, 0x6ed9eba1};
+
+            V r[4] = {state[0], state[1], state[2], state[3]};
+            #pragma GCC unroll 80
+            for (int round = 0; round < 3; ++round)
+            {
+                #pragma GCC unroll 80
+                for (int i = 0; i < 16; ++i)
+                {
+                    int a = (4 - i % 4) % 4;
+                    const V& b = r[(a + 1) % 4];
+                    const V& c = r[(a + 2) % 4];
+                    const V& d = r[(a + 3) % 4];
+
+                    V f;
+                    if (round == 0)
+                        f = d ^ (b & (c ^ d));
+                    else if (round == 1)
+                        f = (b & c) | (d & (b | c));
+                    else
+                        f = b ^ c ^ d;
+
+                    V t = r[a] + f + M[Order[round][i]] + Constant[round];
+                    int s = Shift[round][i % 4];
+                    r[a] = (t << s) | (t >> (32 - s));
+                }
+            }
+
+            state[0] += r[0];
+            state[1] += r[1];
+            state[2] += r[2];
+            state[3] += r[3];
+        }
+    };
+}
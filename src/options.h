@@ -0,0 +1,97 @@
+#pragma once
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <limits>
+#include <stdexcept>
+
+namespace Cli
+{
+    // Minimal command line parser: "--name value" pairs, bare "--flag" switches
+    // and positional arguments, in any order. Names listed in flags never take a
+    // value, so a positional argument may follow them; names in neither flags nor
+    // values are rejected, so a misspelt option does not silently fall back to
+    // its default.
+    class Options
+    {
+    public:
+        Options(int argc, char** argv, const std::set<std::string>& flags = {}, const std::set<std::string>& values = {})
+        {
+            for (int i = 0; i < argc; ++i)
+            {
+                std::string arg = argv[i];
+                if (arg.rfind("--", 0) != 0)
+                {
+                    positional_.push_back(arg);
+                    continue;
+                }
+
+                std::string name = arg.substr(2);
+                if (flags.count(name) == 0 && values.count(name) == 0)
+                    throw std::invalid_argument("Unknown option --" + name + ".");
+                if (flags.count(name) == 0 && i + 1 < argc && std::string(argv[i + 1]).rfind("--", 0) != 0)
+                    values_[name] = argv[++i];
+                else
+                    values_[name] = "";
+            }
+        }
+
+        bool has(const std::string& name) const
+        {
+            return values_.count(name) != 0;
+        }
+
+        std::string get(const std::string& name, const std::string& fallback = "") const
+        {
+            auto it = values_.find(name);
+            return it == values_.end() ? fallback : it->second;
+        }
+
+        size_t getSize(const std::string& name, size_t fallback) const
+        {
+            auto it = values_.find(name);
+            if (it == values_.end())
+                return fallback;
+
+            // std::stoull would accept (and wrap) a leading '-' or skip leading spaces
+            try
+            {
+                if (it->second.empty() || it->second[0] < '0' || it->second[0] > '9')
+                    throw std::invalid_argument(it->second);
+                size_t consumed = 0;
+                unsigned long long value = std::stoull(it->second, &consumed);
+                if (consumed != it->second.size() || value > std::numeric_limits<size_t>::max())
+                    throw std::invalid_argument(it->second);
+                return static_cast<size_t>(value);
+            }
+            catch (const std::exception&)
+            {
+                throw std::invalid_argument("Option --" + name + " expects a non-negative number, got '" + it->second + "'.");
+            }
+        }
+
+        // getSize() for options stored as int, e.g. worker counts, within [min, max]
+        int getInt(const std::string& name, int fallback, int min = 1, int max = std::numeric_limits<int>::max()) const
+        {
+            if (!has(name))
+                return fallback;
+
+            size_t value = getSize(name, 0);
+            if (value < static_cast<size_t>(min) || value > static_cast<size_t>(max))
+                throw std::invalid_argument("Option --" + name + " expects a number from " + std::to_string(min) + " to " +
+                                            std::to_string(max) + ", got '" + get(name) + "'.");
+            return static_cast<int>(value);
+        }
+
+        const std::vector<std::string>& positional() const
+        {
+            return positional_;
+        }
+
+    private:
+        std::map<std::string, std::string> values_;
+        std::vector<std::string> positional_;
+    };
+}
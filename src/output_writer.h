@@ -0,0 +1,359 @@
+#pragma once
+
+#include <fcntl.h>
+#include <semaphore.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <chrono>
+#include <ctime>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "index.h"
+#include "shared_memory.h"
+
+namespace Output
+{
+    // Layout of the records workers emit
+    enum class Format
+    {
+        Text,  // "<hex digest>:<candidate>\n"
+        Binary // raw digest bytes followed by the 16-byte little-endian index
+    };
+
+    inline Format parseFormat(const std::string& name)
+    {
+        if (name == "text")
+            return Format::Text;
+        if (name == "binary")
+            return Format::Binary;
+        throw std::invalid_argument("Unknown output format '" + name + "', expected 'text' or 'binary'.");
+    }
+
+    // Single-producer single-consumer byte ring in shared memory, one per worker.
+    // head and tail only ever grow; the producer owns tail and the consumer head,
+    // each on its own cache line. The producer publishes whole records only, so
+    // the bytes between head and tail never end mid-record.
+    struct alignas(64) Ring
+    {
+        static constexpr size_t Capacity = size_t{1} << 20;
+        // Fill level at which the writer is woken. Well below the capacity, so a
+        // lone worker never waits on a ring that is not yet worth writing.
+        static constexpr size_t DrainSize = Capacity / 4;
+
+        alignas(64) std::atomic<uint64_t> head{0};
+        alignas(64) std::atomic<uint64_t> tail{0};
+        // Set when the writer gave up, so producers stop waiting for room
+        std::atomic<bool> closed{false};
+        alignas(64) char data[Capacity];
+    };
+
+    // Where one worker's records go: its ring and the writer's wake-up semaphore
+    struct Channel
+    {
+        Ring* ring = nullptr;
+        sem_t* wake = nullptr;
+    };
+
+    // Worker side of a ring. Records are collected in a private buffer and moved
+    // into the ring in large pieces, so the shared indices are touched once per
+    // buffer, not once per record. A full ring makes the worker wait for the
+    // writer, which is the only way output slows hashing down.
+    class Producer
+    {
+    public:
+        static constexpr size_t BufferSize = size_t{64} << 10;
+
+        explicit Producer(Channel channel)
+            : ring_(*channel.ring), wake_(*channel.wake), buffer_(BufferSize), used_(0)
+        {
+            static_assert(BufferSize <= Ring::Capacity, "A whole buffer has to fit into the ring.");
+        }
+
+        Producer(const Producer&) = delete;
+        Producer& operator=(const Producer&) = delete;
+
+        ~Producer()
+        {
+            flush();
+        }
+
+        // "<hex of digest>:<key>\n"
+        void text(const uint8_t* digest, size_t digest_size, const char* key, size_t key_size)
+        {
+            static const HexPairs pairs;
+            char* out = reserve(digest_size * 2 + key_size + 2);
+            for (size_t i = 0; i < digest_size; ++i)
+                std::memcpy(out + i * 2, pairs.text[digest[i]], 2);
+            out += digest_size * 2;
+            *out++ = ':';
+            std::memcpy(out, key, key_size);
+            out[key_size] = '\n';
+        }
+
+        // Digest bytes and the index of its candidate
+        void binary(const uint8_t* digest, size_t digest_size, Generators::Index index)
+        {
+            char* out = reserve(digest_size + 16);
+            std::memcpy(out, digest, digest_size);
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            std::memcpy(out + digest_size, &index, 16);
+#else
+            for (size_t i = 0; i < 16; ++i)
+                out[digest_size + i] = static_cast<char>(static_cast<uint8_t>(index >> (i * 8)));
+#endif
+        }
+
+        // Moves the buffered records into the ring in one piece, waiting for the
+        // writer to make room if needed
+        void flush()
+        {
+            if (used_ == 0)
+                return;
+
+            uint64_t tail = ring_.tail.load(std::memory_order_relaxed);
+            uint64_t filled = tail - ring_.head.load(std::memory_order_acquire);
+            if (Ring::Capacity - filled < used_)
+            {
+                sem_post(&wake_);
+                do
+                {
+                    // Nobody is draining any more; the records are lost either way
+                    if (ring_.closed.load(std::memory_order_relaxed))
+                    {
+                        used_ = 0;
+                        return;
+                    }
+                    // Sleeping rather than spinning leaves the core to the writer
+                    // when both share one
+                    std::this_thread::sleep_for(std::chrono::microseconds(50));
+                    filled = tail - ring_.head.load(std::memory_order_acquire);
+                } while (Ring::Capacity - filled < used_);
+            }
+
+            // At most two copies, around the end of the ring
+            size_t at = static_cast<size_t>(tail % Ring::Capacity);
+            size_t first = std::min(used_, Ring::Capacity - at);
+            std::memcpy(ring_.data + at, buffer_.data(), first);
+            std::memcpy(ring_.data, buffer_.data() + first, used_ - first);
+            ring_.tail.store(tail + used_, std::memory_order_release);
+            if (filled < Ring::DrainSize && filled + used_ >= Ring::DrainSize)
+                sem_post(&wake_);
+            used_ = 0;
+        }
+
+    private:
+        // Two hex characters for every byte value, so a digest byte is one copy
+        struct HexPairs
+        {
+            char text[256][2];
+
+            HexPairs()
+            {
+                static constexpr char hex[] = "0123456789abcdef";
+                for (int i = 0; i < 256; ++i)
+                {
+                    text[i][0] = hex[i >> 4];
+                    text[i][1] = hex[i & 0x0F];
+                }
+            }
+        };
+
+        Ring& ring_;
+        sem_t& wake_;
+        std::vector<char> buffer_;
+        size_t used_;
+
+        char* reserve(size_t size)
+        {
+            if (used_ + size > buffer_.size())
+                flush();
+            char* out = buffer_.data() + used_;
+            used_ += size;
+            return out;
+        }
+    };
+
+    // Output file fed by one ring per worker. The rings live in shared memory, so
+    // forked workers and threads write the same way; a thread of the parent drains
+    // them with large writev() calls, woken through a process-shared semaphore when
+    // a ring fills up. Create it before the workers start, call start() once they
+    // are running and finish() once they have all returned.
+    class Writer
+    {
+    public:
+        Writer(const std::string& path, int num_workers)
+            : path_(path), rings_(num_workers > 0 ? num_workers : 1)
+        {
+            if (sem_init(wake_.get(), 1, 0) != 0)
+                throw std::runtime_error(std::string("Semaphore initialisation failed: ") + strerror(errno));
+            fd_ = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (fd_ < 0)
+            {
+                sem_destroy(wake_.get());
+                throw std::runtime_error("Unable to open file '" + path + "': " + strerror(errno));
+            }
+        }
+
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+
+        ~Writer()
+        {
+            try
+            {
+                finish();
+            }
+            catch (const std::exception& ex)
+            {
+                fprintf(stderr, "Output failed: %s\n", ex.what());
+            }
+            close(fd_);
+            sem_destroy(wake_.get());
+        }
+
+        // Records of worker_id go through this
+        Channel channel(int worker_id) const
+        {
+            return {&rings_[worker_id], wake_.get()};
+        }
+
+        // Starts draining in the background; call after fork() so the children
+        // never inherit the thread
+        void start()
+        {
+            thread_ = std::jthread([this](std::stop_token token) { loop(token); });
+        }
+
+        // Writes whatever the workers left behind; they must have returned
+        void finish()
+        {
+            if (thread_.joinable())
+            {
+                thread_.request_stop();
+                sem_post(wake_.get());
+                thread_.join();
+            }
+            if (!failure_.empty())
+                throw std::runtime_error(failure_);
+            drain(0);
+        }
+
+        // Bytes written so far
+        uint64_t bytes() const
+        {
+            return written_;
+        }
+
+    private:
+        std::string path_;
+        LoadBalancing::SharedMemory<Ring> rings_;
+        LoadBalancing::SharedMemory<sem_t> wake_;
+        int fd_;
+        uint64_t written_ = 0;
+        // Why the background drain stopped; empty while it is fine
+        std::string failure_;
+        std::jthread thread_;
+
+        void loop(std::stop_token token)
+        {
+            bool quiet = false;
+            while (!token.stop_requested())
+            {
+                try
+                {
+                    if (drain(quiet ? 0 : Ring::DrainSize))
+                        continue;
+                }
+                catch (const std::exception& ex)
+                {
+                    // Reported by finish(); the workers are released from waiting
+                    failure_ = ex.what();
+                    for (size_t i = 0; i < rings_.size(); ++i)
+                        rings_[i].closed.store(true, std::memory_order_relaxed);
+                    return;
+                }
+
+                // Woken when a ring fills up; after a few quiet milliseconds the
+                // smaller leftovers are written too, so a slow job's output does
+                // not wait for finish()
+                timespec deadline;
+                clock_gettime(CLOCK_REALTIME, &deadline);
+                deadline.tv_nsec += 5000000;
+                if (deadline.tv_nsec >= 1000000000)
+                {
+                    deadline.tv_sec += 1;
+                    deadline.tv_nsec -= 1000000000;
+                }
+                quiet = sem_timedwait(wake_.get(), &deadline) != 0 && errno == ETIMEDOUT;
+            }
+        }
+
+        // Writes all complete records in the rings if there are at least minimum
+        // bytes of them, and returns whether anything was written
+        bool drain(size_t minimum)
+        {
+            std::vector<iovec> pieces;
+            std::vector<uint64_t> tails(rings_.size());
+            size_t total = 0;
+            for (size_t i = 0; i < rings_.size(); ++i)
+            {
+                Ring& ring = rings_[i];
+                uint64_t head = ring.head.load(std::memory_order_relaxed);
+                tails[i] = ring.tail.load(std::memory_order_acquire);
+                size_t count = static_cast<size_t>(tails[i] - head);
+                size_t at = static_cast<size_t>(head % Ring::Capacity);
+                size_t first = std::min(count, Ring::Capacity - at);
+                if (first != 0)
+                    pieces.push_back({ring.data + at, first});
+                if (count != first)
+                    pieces.push_back({ring.data, count - first});
+                total += count;
+            }
+            if (total == 0 || total < minimum)
+                return false;
+
+            writeAll(pieces);
+            for (size_t i = 0; i < rings_.size(); ++i)
+                rings_[i].head.store(tails[i], std::memory_order_release);
+            written_ += total;
+            return true;
+        }
+
+        void writeAll(std::vector<iovec>& pieces)
+        {
+            size_t next = 0;
+            while (next < pieces.size())
+            {
+                int count = static_cast<int>(std::min<size_t>(pieces.size() - next, IOV_MAX));
+                ssize_t result = writev(fd_, pieces.data() + next, count);
+                if (result < 0)
+                {
+                    if (errno == EINTR)
+                        continue;
+                    throw std::runtime_error("Unable to write file '" + path_ + "': " + strerror(errno));
+                }
+
+                // Skip what was written; a short write resumes mid-piece
+                size_t done = static_cast<size_t>(result);
+                while (next < pieces.size() && done >= pieces[next].iov_len)
+                    done -= pieces[next++].iov_len;
+                if (done != 0)
+                {
+                    pieces[next].iov_base = static_cast<char*>(pieces[next].iov_base) + done;
+                    pieces[next].iov_len -= done;
+                }
+            }
+        }
+    };
+}
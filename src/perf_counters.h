@@ -0,0 +1,277 @@
+#pragma once
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "shared_memory.h"
+
+namespace Profiling
+{
+    // Events counted for every worker
+    enum Event
+    {
+        Cycles,
+        Instructions,
+        L1dMisses,
+        LlcMisses,
+        BranchMisses,
+        ContextSwitches,
+        EventCount
+    };
+
+    inline const char* eventName(int event)
+    {
+        static constexpr const char* names[EventCount] = {"cycles", "instructions", "l1d-misses", "llc-misses",
+                                                          "branch-misses", "context-switches"};
+        return names[event];
+    }
+
+    // Counts of one worker (or the sum over workers). An event the kernel refused
+    // to open is missing from available and its count stays 0.
+    struct Counts
+    {
+        std::array<uint64_t, EventCount> values = {};
+        uint32_t available = 0;
+
+        bool has(int event) const
+        {
+            return (available >> event) & 1;
+        }
+
+        uint64_t operator[](int event) const
+        {
+            return values[event];
+        }
+
+        Counts& operator+=(const Counts& other)
+        {
+            for (int i = 0; i < EventCount; ++i)
+                values[i] += other.values[i];
+            available |= other.available;
+            return *this;
+        }
+
+        // Instructions per cycle; 0 without both counters
+        double ipc() const
+        {
+            return (has(Cycles) && has(Instructions) && values[Cycles] != 0)
+                       ? static_cast<double>(values[Instructions]) / values[Cycles]
+                       : 0;
+        }
+
+        // Candidates hashed per cycle; 0 without a cycle counter
+        double perCycle(uint64_t processed) const
+        {
+            return (has(Cycles) && values[Cycles] != 0) ? static_cast<double>(processed) / values[Cycles] : 0;
+        }
+    };
+
+    // Counters of the calling thread (the whole process in a forked child), from
+    // construction until stop(). Every event is opened on its own, so a machine
+    // without, say, LLC events still reports the rest; reads are scaled by the
+    // time each event actually ran when the PMU had to multiplex them.
+    class ThreadCounters
+    {
+    public:
+        ThreadCounters()
+        {
+            fds_.fill(-1);
+            for (int event = 0; event < EventCount; ++event)
+            {
+                perf_event_attr attr = attributes(event);
+                long fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+                if (fd >= 0)
+                    fds_[event] = static_cast<int>(fd);
+                else if (error_ == 0)
+                    error_ = errno;
+            }
+
+            for (int fd : fds_)
+            {
+                if (fd >= 0)
+                    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            }
+            for (int fd : fds_)
+            {
+                if (fd >= 0)
+                    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+
+        ThreadCounters(const ThreadCounters&) = delete;
+        ThreadCounters& operator=(const ThreadCounters&) = delete;
+
+        ~ThreadCounters()
+        {
+            for (int fd : fds_)
+            {
+                if (fd >= 0)
+                    close(fd);
+            }
+        }
+
+        // Disables the counters and returns what they counted
+        Counts stop()
+        {
+            for (int fd : fds_)
+            {
+                if (fd >= 0)
+                    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            }
+
+            Counts counts;
+            for (int event = 0; event < EventCount; ++event)
+            {
+                uint64_t data[3]; // value, time enabled, time running
+                if (fds_[event] < 0 || read(fds_[event], data, sizeof(data)) != sizeof(data))
+                    continue;
+
+                if (data[2] != 0 && data[2] < data[1])
+                    data[0] = static_cast<uint64_t>(static_cast<double>(data[0]) * data[1] / data[2]);
+                counts.values[event] = data[0];
+                counts.available |= 1u << event;
+            }
+            return counts;
+        }
+
+        // errno of the first event that could not be opened, 0 when all were
+        int error() const
+        {
+            return error_;
+        }
+
+    private:
+        std::array<int, EventCount> fds_;
+        int error_ = 0;
+
+        static perf_event_attr attributes(int event)
+        {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+            auto cache = [](uint64_t cache_id)
+            {
+                return cache_id | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            };
+
+            switch (event)
+            {
+            case Cycles:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_CPU_CYCLES;
+                break;
+            case Instructions:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+                break;
+            case L1dMisses:
+                attr.type = PERF_TYPE_HW_CACHE;
+                attr.config = cache(PERF_COUNT_HW_CACHE_L1D);
+                break;
+            case LlcMisses:
+                attr.type = PERF_TYPE_HW_CACHE;
+                attr.config = cache(PERF_COUNT_HW_CACHE_LL);
+                break;
+            case BranchMisses:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+                break;
+            default:
+                // Scheduler events are only visible with the kernel included
+                attr.type = PERF_TYPE_SOFTWARE;
+                attr.config = PERF_COUNT_SW_CONTEXT_SWITCHES;
+                attr.exclude_kernel = 0;
+                break;
+            }
+            return attr;
+        }
+    };
+
+    // One worker's counts in shared memory, written once when the worker ends
+    struct alignas(64) CounterSlot
+    {
+        std::array<std::atomic<uint64_t>, EventCount> values{};
+        std::atomic<uint32_t> available{0};
+        std::atomic<int> error{0};
+    };
+
+    // Per-worker counters collected in the parent. Created before the workers
+    // start and handed to LoadBalancer through WorkerOptions::counters, which
+    // wraps each worker's task in a ThreadCounters.
+    class PerfCounters
+    {
+    public:
+        explicit PerfCounters(int num_workers)
+            : slots_(num_workers > 0 ? num_workers : 1)
+        {
+        }
+
+        int workers() const
+        {
+            return static_cast<int>(slots_.size());
+        }
+
+        // Called by worker worker_id once its task has returned
+        void record(int worker_id, const Counts& counts, int error)
+        {
+            CounterSlot& slot = slots_[worker_id];
+            for (int i = 0; i < EventCount; ++i)
+                slot.values[i].store(counts.values[i], std::memory_order_relaxed);
+            slot.error.store(error, std::memory_order_relaxed);
+            slot.available.store(counts.available, std::memory_order_release);
+        }
+
+        Counts worker(int worker_id) const
+        {
+            const CounterSlot& slot = slots_[worker_id];
+            Counts counts;
+            counts.available = slot.available.load(std::memory_order_acquire);
+            for (int i = 0; i < EventCount; ++i)
+                counts.values[i] = slot.values[i].load(std::memory_order_relaxed);
+            return counts;
+        }
+
+        Counts total() const
+        {
+            Counts sum;
+            for (int i = 0; i < workers(); ++i)
+                sum += worker(i);
+            return sum;
+        }
+
+        // Why events are missing, e.g. for a note next to the report; empty when none are
+        std::string unavailableReason() const
+        {
+            for (int i = 0; i < workers(); ++i)
+            {
+                int error = slots_[i].error.load(std::memory_order_relaxed);
+                if (error == 0)
+                    continue;
+                if (error == EACCES || error == EPERM)
+                    return "not permitted (see /proc/sys/kernel/perf_event_paranoid)";
+                if (error == ENOENT || error == EOPNOTSUPP)
+                    return "not supported by this CPU or hypervisor";
+                if (error == ENOSYS)
+                    return "perf_event_open is not available";
+                return strerror(error);
+            }
+            return "";
+        }
+
+    private:
+        LoadBalancing::SharedMemory<CounterSlot> slots_;
+    };
+}
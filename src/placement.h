@@ -0,0 +1,145 @@
+#pragma once
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <cstdio>
+#include <vector>
+#include <memory>
+#include <new>
+
+#include "mapped_file.h"
+
+namespace Placement
+{
+    // CPUs this process may run on, in ascending order
+    inline std::vector<int> allowedCpus()
+    {
+        std::vector<int> cpus;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) == 0)
+        {
+            for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+            {
+                if (CPU_ISSET(cpu, &set))
+                    cpus.push_back(cpu);
+            }
+        }
+        return cpus;
+    }
+
+    // Pins the calling thread to the worker_id-th allowed CPU (wrapping around).
+    // In a forked child this pins the whole process.
+    inline bool pinCurrentThread(int worker_id)
+    {
+        static const std::vector<int> cpus = allowedCpus();
+        if (cpus.empty())
+            return false;
+
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpus[static_cast<size_t>(worker_id) % cpus.size()], &set);
+        return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+    }
+
+    // Number of online NUMA nodes; 1 when the kernel does not expose them
+    inline int nodeCount()
+    {
+        static const int count = []()
+        {
+            FILE* file = fopen("/sys/devices/system/node/online", "r");
+            if (file == nullptr)
+                return 1;
+
+            // Format is a list of ranges such as "0" or "0-1,3"
+            int nodes = 0, first, last;
+            while (fscanf(file, "%d", &first) == 1)
+            {
+                last = first;
+                int next = fgetc(file);
+                if (next == '-' && fscanf(file, "%d", &last) == 1)
+                    next = fgetc(file);
+                nodes += last - first + 1;
+                if (next != ',')
+                    break;
+            }
+            fclose(file);
+            return nodes > 0 ? nodes : 1;
+        }();
+        return count;
+    }
+
+    // NUMA node of the CPU the caller is running on
+    inline int currentNode()
+    {
+        unsigned cpu = 0, node = 0;
+        if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0)
+            return 0;
+        return static_cast<int>(node);
+    }
+
+    // Binds a page-aligned, not yet touched range to the caller's NUMA node with
+    // mbind(MPOL_BIND). Does nothing on single-node machines.
+    inline bool bindLocal(void* address, size_t bytes)
+    {
+        if (nodeCount() <= 1)
+            return false;
+
+        int node = currentNode();
+        if (node >= 64)
+            return false;
+
+        // MPOL_BIND from <numaif.h>; spelled out to avoid depending on libnuma
+        constexpr int MpolBind = 2;
+        unsigned long mask = 1ul << node;
+        return syscall(SYS_mbind, address, bytes, MpolBind, &mask, sizeof(mask) * 8 + 1, 0) == 0;
+    }
+
+    // Per-worker scratch object. With node_local set it lives in its own mapping
+    // bound to the worker's NUMA node before the first touch, otherwise on the heap.
+    template <typename T>
+    class LocalBuffer
+    {
+    public:
+        explicit LocalBuffer(bool node_local)
+        {
+            if (node_local)
+            {
+                region_ = Storage::MappedRegion(sizeof(T));
+                bindLocal(region_.as<void>(), region_.size());
+                object_ = new (region_.as<void>()) T();
+            }
+            else
+            {
+                heap_ = std::make_unique<T>();
+                object_ = heap_.get();
+            }
+        }
+
+        LocalBuffer(const LocalBuffer&) = delete;
+        LocalBuffer& operator=(const LocalBuffer&) = delete;
+
+        ~LocalBuffer()
+        {
+            if (region_.size() != 0)
+                object_->~T();
+        }
+
+        T& operator*() const
+        {
+            return *object_;
+        }
+
+        T* operator->() const
+        {
+            return object_;
+        }
+
+    private:
+        Storage::MappedRegion region_;
+        std::unique_ptr<T> heap_;
+        T* object_ = nullptr;
+    };
+}
@@ -3,22 +3,26 @@
 #include <string>
 #include <fstream>
 #include <stdexcept>
-#
+#include <cstdint>
+
+#include "perf_counters.h"
 
 namespace Results
 {
     typedef std::map<int, double> ResultsTable;
+    // Summed hardware events of all workers per fork count
+    typedef std::map<int, Profiling::Counts> CountersTable;
 
     class ResultsWriter
     {
     public:
-        static void writeResultsCsv(ResultsTable table, std::string filename)
+        static void writeResultsCsv(const ResultsTable& table, const std::string& filename)
         {
             std::ofstream csvFile(filename);
 
             if (!csvFile.is_open())
             {
-                throw std::runtime_error("Unable to open file '1znaky.csv'");
+                throw std::runtime_error("Unable to open file '" + filename + "'");
             }
 
             csvFile << "FORKS,TIME\n";
@@ -30,5 +34,37 @@ namespace Results
             
             csvFile.close();
         }
+
+        // Counters next to the timings of the same size; joined on FORKS. Events the
+        // machine could not count are left empty.
+        static void writeCountersCsv(const CountersTable& table, uint64_t candidates, const std::string& filename)
+        {
+            std::ofstream csvFile(filename);
+
+            if (!csvFile.is_open())
+            {
+                throw std::runtime_error("Unable to open file '" + filename + "'");
+            }
+
+            csvFile << "FORKS,CYCLES,INSTRUCTIONS,L1D_MISSES,LLC_MISSES,BRANCH_MISSES,CONTEXT_SWITCHES,IPC,HASHES_PER_CYCLE\n";
+
+            for (const auto &[forks, counts] : table)
+            {
+                csvFile << forks;
+                for (int event = 0; event < Profiling::EventCount; ++event)
+                {
+                    csvFile << ",";
+                    if (counts.has(event))
+                        csvFile << counts[event];
+                }
+                csvFile << ",";
+                if (counts.ipc() != 0)
+                    csvFile << counts.ipc();
+                csvFile << ",";
+                if (counts.perCycle(candidates) != 0)
+                    csvFile << counts.perCycle(candidates);
+                csvFile << "\n";
+            }
+        }
     };
 }
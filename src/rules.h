@@ -0,0 +1,203 @@
+#pragma once
+
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <stdexcept>
+
+namespace Dictionary
+{
+    // Word mangling rule in a subset of the hashcat rule syntax. Functions are
+    // applied left to right; spaces between them are ignored:
+    //
+    //   :    keep the word as is      l / u  lower / upper case
+    //   c    capitalize               C      lower the first, upper the rest
+    //   t    toggle every letter      TN     toggle the letter at position N
+    //   $X   append X                 ^X     prepend X
+    //   sXY  replace every X with Y (leetspeak, e.g. "sa4 se3 so0")
+    //
+    // Positions are 0-9 then A-Z for 10-35.
+    class Rule
+    {
+    public:
+        static Rule parse(std::string_view text)
+        {
+            Rule rule;
+            rule.text_ = std::string(text);
+            for (size_t i = 0; i < text.size(); ++i)
+            {
+                char code = text[i];
+                size_t operands = 0;
+                switch (code)
+                {
+                case ' ':
+                case ':':
+                    continue;
+                case 'l':
+                case 'u':
+                case 'c':
+                case 'C':
+                case 't':
+                    break;
+                case 'T':
+                case '$':
+                case '^':
+                    operands = 1;
+                    break;
+                case 's':
+                    operands = 2;
+                    break;
+                default:
+                    throw std::invalid_argument("Unknown rule function '" + std::string(1, code) + "' in rule '" + rule.text_ + "'.");
+                }
+
+                if (i + operands >= text.size())
+                    throw std::invalid_argument("Rule '" + rule.text_ + "' ends in the middle of a function.");
+
+                Op op{code, operands > 0 ? text[i + 1] : '\0', operands > 1 ? text[i + 2] : '\0'};
+                if (code == 'T')
+                {
+                    int position = positionOf(op.a);
+                    if (position < 0)
+                        throw std::invalid_argument("Invalid position in rule '" + rule.text_ + "'.");
+                    op.a = static_cast<char>(position);
+                }
+                rule.ops_.push_back(op);
+                i += operands;
+            }
+            return rule;
+        }
+
+        // Writes the mangled word into out, which holds capacity bytes. Returns
+        // false when the result would not fit.
+        bool apply(std::string_view word, char* out, size_t capacity, size_t& length) const
+        {
+            if (word.size() > capacity)
+                return false;
+            std::memcpy(out, word.data(), word.size());
+            length = word.size();
+
+            for (const Op& op : ops_)
+            {
+                switch (op.code)
+                {
+                case 'l':
+                    for (size_t i = 0; i < length; ++i)
+                        out[i] = lower(out[i]);
+                    break;
+                case 'u':
+                    for (size_t i = 0; i < length; ++i)
+                        out[i] = upper(out[i]);
+                    break;
+                case 'c':
+                case 'C':
+                    for (size_t i = 0; i < length; ++i)
+                        out[i] = ((i == 0) == (op.code == 'c')) ? upper(out[i]) : lower(out[i]);
+                    break;
+                case 't':
+                    for (size_t i = 0; i < length; ++i)
+                        out[i] = toggle(out[i]);
+                    break;
+                case 'T':
+                    if (static_cast<size_t>(op.a) < length)
+                        out[static_cast<size_t>(op.a)] = toggle(out[static_cast<size_t>(op.a)]);
+                    break;
+                case '$':
+                    if (length == capacity)
+                        return false;
+                    out[length++] = op.a;
+                    break;
+                case '^':
+                    if (length == capacity)
+                        return false;
+                    std::memmove(out + 1, out, length++);
+                    out[0] = op.a;
+                    break;
+                case 's':
+                    for (size_t i = 0; i < length; ++i)
+                    {
+                        if (out[i] == op.a)
+                            out[i] = op.b;
+                    }
+                    break;
+                }
+            }
+            return true;
+        }
+
+        std::string apply(std::string_view word) const
+        {
+            std::string result(word.size() + ops_.size(), '\0');
+            size_t length = 0;
+            apply(word, result.data(), result.size(), length);
+            result.resize(length);
+            return result;
+        }
+
+        const std::string& text() const
+        {
+            return text_;
+        }
+
+        // One rule per line; blank lines and lines starting with '#' are skipped
+        static std::vector<Rule> load(const std::string& path)
+        {
+            std::ifstream file(path);
+            if (!file.is_open())
+                throw std::runtime_error("Unable to open file '" + path + "'");
+
+            std::vector<Rule> rules;
+            std::string line;
+            while (std::getline(file, line))
+            {
+                if (!line.empty() && line.back() == '\r')
+                    line.pop_back();
+                if (line.empty() || line.front() == '#')
+                    continue;
+                rules.push_back(parse(line));
+            }
+
+            if (rules.empty())
+                throw std::runtime_error("Rule file '" + path + "' has no rules.");
+            return rules;
+        }
+
+    private:
+        struct Op
+        {
+            char code;
+            char a;
+            char b;
+        };
+
+        std::string text_;
+        std::vector<Op> ops_;
+
+        static int positionOf(char c)
+        {
+            if (c >= '0' && c <= '9')
+                return c - '0';
+            if (c >= 'A' && c <= 'Z')
+                return c - 'A' + 10;
+            return -1;
+        }
+
+        static char lower(char c)
+        {
+            return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        }
+
+        static char upper(char c)
+        {
+            return static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+        }
+
+        static char toggle(char c)
+        {
+            return std::islower(static_cast<unsigned char>(c)) ? upper(c) : lower(c);
+        }
+    };
+}
@@ -0,0 +1,199 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+
+#include "index.h"
+#include "shared_memory.h"
+
+namespace LoadBalancing
+{
+    using Generators::Index;
+
+    // Half-open range of keyspace indices [begin, end)
+    struct Range
+    {
+        Index begin;
+        Index end;
+
+        Index size() const
+        {
+            return end - begin;
+        }
+    };
+
+    // Part k of n equal parts of range; the first size % n parts take one extra index
+    inline Range slice(const Range& range, size_t k, size_t n)
+    {
+        Index chunk = range.size() / n;
+        Index extra = range.size() % n;
+        Index begin = range.begin + chunk * k + std::min<Index>(k, extra);
+        Index count = chunk + (k < extra ? 1 : 0);
+        return {begin, begin + count};
+    }
+
+    // Dynamic chunking over a list of index ranges.
+    //
+    // The ranges are concatenated into one virtual index space whose cursor lives
+    // in shared memory; workers claim chunks from it with a CAS. Chunk sizes are
+    // guided: remaining / (2 * workers), clamped to [min_chunk, max_chunk], so early
+    // chunks are large and the tail is split finely. A fast worker simply claims
+    // more chunks, so the sweep ends when the average worker runs out of work
+    // rather than when the slowest fixed slice is done.
+    //
+    // Range bounds are 128-bit, but the cursor is a 64-bit offset into the
+    // virtual space, so one scheduler handles at most 2^64 - 1 indices; larger
+    // keyspaces have to be sharded first (see slice()).
+    class DynamicScheduler
+    {
+    public:
+        static constexpr size_t DefaultMaxChunk = 1 << 22;
+
+        DynamicScheduler(std::vector<Range> ranges, int num_workers,
+                         size_t min_chunk = 1 << 12, size_t max_chunk = DefaultMaxChunk)
+            : ranges_(std::move(ranges)), num_workers_(num_workers), min_chunk_(min_chunk), max_chunk_(max_chunk),
+              leases_(num_workers > 0 ? num_workers : 1)
+        {
+            if (num_workers_ < 1)
+                throw std::invalid_argument("Number of workers must be at least 1.");
+            if (min_chunk_ == 0 || min_chunk_ > max_chunk_)
+                throw std::invalid_argument("Chunk bounds must satisfy 0 < min_chunk <= max_chunk.");
+
+            // Drop empty ranges and remember where each one starts in the virtual space
+            ranges_.erase(std::remove_if(ranges_.begin(), ranges_.end(), [](const Range& r) { return r.end <= r.begin; }),
+                          ranges_.end());
+            for (const Range& range : ranges_)
+            {
+                if (range.size() > std::numeric_limits<size_t>::max() - total_)
+                    throw std::overflow_error("Scheduled ranges exceed 2^64 indices; shard the keyspace first.");
+                offsets_.push_back(total_);
+                total_ += static_cast<size_t>(range.size());
+            }
+        }
+
+        // Claims the next chunk; returns false once everything has been handed out.
+        // A chunk never spans two ranges.
+        bool claim(Range& chunk)
+        {
+            size_t cursor = shared_->cursor.load(std::memory_order_relaxed);
+            while (true)
+            {
+                if (cursor >= total_)
+                    return false;
+
+                size_t size = chunkSize(total_ - cursor, num_workers_, min_chunk_, max_chunk_);
+
+                // Find the range holding the cursor and stop the chunk at its end
+                size_t r = static_cast<size_t>(std::upper_bound(offsets_.begin(), offsets_.end(), cursor) - offsets_.begin()) - 1;
+                size_t local = cursor - offsets_[r];
+                size = std::min(size, static_cast<size_t>(ranges_[r].size()) - local);
+
+                // Release, so outstanding() sees a lease claim that precedes the cursor it read
+                if (shared_->cursor.compare_exchange_weak(cursor, cursor + size, std::memory_order_acq_rel, std::memory_order_relaxed))
+                {
+                    chunk = {ranges_[r].begin + local, ranges_[r].begin + local + size};
+                    return true;
+                }
+            }
+        }
+
+        // Same as claim(), but also records the chunk as the worker's lease so
+        // outstanding() can tell which claimed work may still be unfinished
+        bool claim(int worker_id, Range& chunk)
+        {
+            Lease& lease = leases_[worker_id];
+            lease.sequence.fetch_add(1); // odd while the claim is in flight
+            bool claimed = claim(chunk);
+            if (claimed)
+            {
+                lease.begin.store(chunk.begin);
+                lease.end.store(chunk.end);
+            }
+            lease.sequence.fetch_add(1, std::memory_order_release);
+            return claimed;
+        }
+
+        // Unclaimed ranges plus the last chunk leased by every worker (indexed by
+        // worker id). Returns false when a claim was in flight and the snapshot
+        // might miss a chunk; the caller should retry.
+        bool outstanding(std::vector<Range>& unclaimed, std::vector<Range>& leases) const
+        {
+            unclaimed.clear();
+            leases.clear();
+
+            size_t cursor = shared_->cursor.load(std::memory_order_acquire);
+            for (size_t r = 0; r < ranges_.size(); ++r)
+            {
+                size_t end = offsets_[r] + static_cast<size_t>(ranges_[r].size());
+                if (cursor < end)
+                    unclaimed.push_back({ranges_[r].begin + (std::max(cursor, offsets_[r]) - offsets_[r]), ranges_[r].end});
+            }
+
+            for (int i = 0; i < num_workers_; ++i)
+            {
+                const Lease& lease = leases_[i];
+                uint64_t sequence = lease.sequence.load(std::memory_order_acquire);
+                if (sequence % 2 != 0)
+                    return false;
+
+                Range range{lease.begin.load(), lease.end.load()};
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (lease.sequence.load(std::memory_order_relaxed) != sequence)
+                    return false;
+                leases.push_back(range);
+            }
+            return true;
+        }
+
+        // Guided chunk size for the given amount of unclaimed work
+        static size_t chunkSize(size_t remaining, int num_workers, size_t min_chunk, size_t max_chunk)
+        {
+            return std::clamp(remaining / (2 * static_cast<size_t>(num_workers)), min_chunk, max_chunk);
+        }
+
+        // Stops handing out chunks; workers finish the chunk they hold
+        void cancel()
+        {
+            shared_->cursor.store(total_, std::memory_order_relaxed);
+        }
+
+        // Number of indices across all ranges
+        size_t total() const
+        {
+            return total_;
+        }
+
+        // Indices not yet claimed by any worker
+        size_t unclaimed() const
+        {
+            size_t cursor = shared_->cursor.load(std::memory_order_relaxed);
+            return cursor >= total_ ? 0 : total_ - cursor;
+        }
+
+    private:
+        struct Shared
+        {
+            std::atomic<size_t> cursor{0};
+        };
+
+        // Chunk most recently claimed by one worker, guarded by a sequence counter
+        struct alignas(64) Lease
+        {
+            std::atomic<uint64_t> sequence{0};
+            Generators::SharedIndex begin;
+            Generators::SharedIndex end;
+        };
+
+        std::vector<Range> ranges_;
+        std::vector<size_t> offsets_;
+        size_t total_ = 0;
+        int num_workers_;
+        size_t min_chunk_;
+        size_t max_chunk_;
+        SharedMemory<Shared> shared_;
+        SharedMemory<Lease> leases_;
+    };
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <array>
+#include <cstdint>
+
+#include "batch_hasher.h"
+
+namespace Hashing
+{
+    typedef std::array<uint32_t, 5> Sha1Digest;
+
+    // SHA-1 (FIPS 180-4) on the BatchHasher lanes
+    class Sha1 : public BatchHasher<Sha1, 5>
+    {
+    public:
+        using BatchHasher::BatchHasher;
+
+        static constexpr const char* Name = "SHA-1";
+        static constexpr bool BigEndian = true;
+        static constexpr bool Utf16 = false;
+        static constexpr std::array<uint32_t, 5> IV = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0};
+
+        // 80 rounds over a rolling 16-word message schedule
+        template <typename V>
+        [[gnu::always_inline]] static inline void compress(V* state, const V* M)
+        {
+            V W[16];
+            for (int t = 0; t < 16; ++t)
+                W[t] = M[t];
+
+            V a = state[0];
+            V b = state[1];
+            V c = state[2];
+            V d = state[3];
+            V e = state[4];
+
+            #pragma GCC unroll 80
+            for (int t = 0; t < 80; ++t)
+            {
+                if (t >= 16)
+                    rotate(W[t & 15], W[(t - 3) & 15] ^ W[(t - 8) & 15] ^ W[(t - 14) & 15] ^ W[t & 15], 1);
+
+                V f;
+                uint32_t k;
+                if (t < 20)
+                {
+                    f = d ^ (b & (c ^ d));
+                    k = 0x5a827999;
+                }
+                else if (t < 40)
+                {
+                    f = b ^ c ^ d;
+                    k = 0x6ed9eba1;
+                }
+                else if (t < 60)
+                {
+                    f = (b & c) | (d & (b | c));
+                    k = 0x8f1bbcdc;
+                }
+                else
+                {
+                    f = b ^ c ^ d;
+                    k = 0xca62c1d6;
+                }
+
+                V temp;
+                rotate(temp, a, 5);
+                temp += f + e + k + W[t & 15];
+                e = d;
+                d = c;
+                rotate(c, b, 30);
+                b = a;
+                a = temp;
+            }
+
+            state[0] += a;
+            state[1] += b;
+            state[2] += c;
+            state[3] += d;
+            state[4] += e;
+        }
+
+    private:
+        // out = x rotated left by n; vectors never cross a function boundary by value
+        template <typename V>
+        [[gnu::always_inline]] static inline void rotate(V& out, const V& x, int n)
+        {
+            out = (x << n) | (x >> (32 - n));
+        }
+    };
+}
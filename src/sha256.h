@@ -0,0 +1,103 @@
+#pragma once
+#include <array>
+#include <cstdint>
+
+#include "batch_hasher.h"
+
+namespace Hashing
+{
+    typedef std::array<uint32_t, 8> Sha256Digest;
+
+    // SHA-256 (FIPS 180-4) on the BatchHasher lanes
+    class Sha256 : public BatchHasher<Sha256, 8>
+    {
+    public:
+        using BatchHasher::BatchHasher;
+
+        static constexpr const char* Name = "SHA-256";
+        static constexpr bool BigEndian = true;
+        static constexpr bool Utf16 = false;
+        static constexpr std::array<uint32_t, 8> IV = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                                                       0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+        static constexpr std::array<uint32_t, 64> K = {
+            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+            0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+            0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+            0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+            0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+            0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+            0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+            0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+        };
+
+        // 64 rounds over a rolling 16-word message schedule
+        template <typename V>
+        [[gnu::always_inline]] static inline void compress(V* state, const V* M)
+        {
+            V W[16];
+            for (int t = 0; t < 16; ++t)
+                W[t] = M[t];
+
+            V a = state[0];
+            V b = state[1];
+            V c = state[2];
+            V d = state[3];
+            V e = state[4];
+            V f = state[5];
+            V g = state[6];
+            V h = state[7];
+
+            #pragma GCC unroll 80
+            for (int t = 0; t < 64; ++t)
+            {
+                if (t >= 16)
+                {
+                    V s0, s1;
+                    sigma(s0, W[(t - 15) & 15], 7, 18);
+                    s0 ^= W[(t - 15) & 15] >> 3;
+                    sigma(s1, W[(t - 2) & 15], 17, 19);
+                    s1 ^= W[(t - 2) & 15] >> 10;
+                    W[t & 15] += s0 + W[(t - 7) & 15] + s1;
+                }
+
+                V S1, S0;
+                sigma(S1, e, 6, 11, 25);
+                V ch = g ^ (e & (f ^ g));
+                V temp1 = h + S1 + ch + K[t] + W[t & 15];
+                sigma(S0, a, 2, 13, 22);
+                V maj = (a & b) | (c & (a | b));
+                V temp2 = S0 + maj;
+
+                h = g;
+                g = f;
+                f = e;
+                e = d + temp1;
+                d = c;
+                c = b;
+                b = a;
+                a = temp1 + temp2;
+            }
+
+            state[0] += a;
+            state[1] += b;
+            state[2] += c;
+            state[3] += d;
+            state[4] += e;
+            state[5] += f;
+            state[6] += g;
+            state[7] += h;
+        }
+
+    private:
+        // out = XOR of x rotated right by each amount (0 adds nothing); vectors
+        // never cross a function boundary by value
+        template <typename V>
+        [[gnu::always_inline]] static inline void sigma(V& out, const V& x, int a, int b, int c = 0)
+        {
+            out = ((x >> a) | (x << (32 - a))) ^ ((x >> b) | (x << (32 - b)));
+            if (c != 0)
+                out ^= (x >> c) | (x << (32 - c));
+        }
+    };
+}
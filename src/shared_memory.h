@@ -0,0 +1,84 @@
+#pragma once
+
+#include <sys/mman.h>
+#include <cstring>
+#include <cerrno>
+#include <new>
+#include <string>
+#include <stdexcept>
+#include <utility>
+
+namespace LoadBalancing
+{
+    // Array of count objects of type T placed in an anonymous MAP_SHARED mapping.
+    // Created by the parent before LoadBalancer::start(), it is visible to every
+    // forked child, so T should only hold lock-free atomics and plain data.
+    template <typename T>
+    class SharedMemory
+    {
+    public:
+        explicit SharedMemory(size_t count = 1)
+            : count_(count)
+        {
+            if (count_ == 0)
+                throw std::invalid_argument("Shared memory must hold at least one object.");
+
+            bytes_ = sizeof(T) * count_;
+            void* memory = mmap(nullptr, bytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+            if (memory == MAP_FAILED)
+                throw std::runtime_error(std::string("Shared memory allocation failed: ") + strerror(errno));
+
+            data_ = static_cast<T*>(memory);
+            for (size_t i = 0; i < count_; ++i)
+                new (data_ + i) T();
+        }
+
+        SharedMemory(const SharedMemory&) = delete;
+        SharedMemory& operator=(const SharedMemory&) = delete;
+
+        SharedMemory(SharedMemory&& other) noexcept
+            : data_(std::exchange(other.data_, nullptr)), count_(other.count_), bytes_(other.bytes_)
+        {
+        }
+
+        ~SharedMemory()
+        {
+            if (data_ == nullptr)
+                return;
+
+            for (size_t i = 0; i < count_; ++i)
+                data_[i].~T();
+            munmap(data_, bytes_);
+        }
+
+        T* get() const
+        {
+            return data_;
+        }
+
+        T& operator*() const
+        {
+            return *data_;
+        }
+
+        T* operator->() const
+        {
+            return data_;
+        }
+
+        T& operator[](size_t i) const
+        {
+            return data_[i];
+        }
+
+        size_t size() const
+        {
+            return count_;
+        }
+
+    private:
+        T* data_ = nullptr;
+        size_t count_;
+        size_t bytes_;
+    };
+}
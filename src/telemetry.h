@@ -0,0 +1,194 @@
+#pragma once
+
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <condition_variable>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+#include "index.h"
+#include "shared_memory.h"
+
+namespace Monitoring
+{
+    // Nanoseconds on the monotonic clock, comparable between forks
+    inline uint64_t nowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Counters of one worker. Each slot has a single writer and sits on its own
+    // cache line, so updates are plain relaxed stores that never bounce between
+    // cores; the parent only reads. The 128-bit position is written in two halves
+    // under a sequence counter so the reader never sees a torn value.
+    struct alignas(64) WorkerSlot
+    {
+        std::atomic<uint64_t> processed{0};
+        std::atomic<uint64_t> matches{0};
+        std::atomic<uint64_t> started_ns{0};
+        std::atomic<uint64_t> updated_ns{0};
+        std::atomic<uint64_t> sequence{0};
+        Generators::SharedIndex position;
+
+        // Called by the owning worker after hashing count candidates ending before next_position
+        void advance(uint64_t count, Generators::Index next_position)
+        {
+            uint64_t now = nowNs();
+            if (started_ns.load(std::memory_order_relaxed) == 0)
+                started_ns.store(now, std::memory_order_relaxed);
+            processed.store(processed.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+
+            uint64_t next = sequence.load(std::memory_order_relaxed) + 1;
+            sequence.store(next, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            position.store(next_position);
+            sequence.store(next + 1, std::memory_order_release);
+
+            updated_ns.store(now, std::memory_order_relaxed);
+        }
+
+        // Consistent read of the position, retried while the worker is writing it
+        Generators::Index readPosition() const
+        {
+            while (true)
+            {
+                uint64_t before = sequence.load(std::memory_order_acquire);
+                Generators::Index value = position.load();
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (before % 2 == 0 && sequence.load(std::memory_order_relaxed) == before)
+                    return value;
+            }
+        }
+
+        void matched()
+        {
+            matches.store(matches.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+    };
+
+    // Snapshot of one worker as seen by the parent
+    struct WorkerStats
+    {
+        uint64_t processed;
+        Generators::Index position;
+        uint64_t matches;
+        double rate; // candidates per second while the worker was busy
+    };
+
+    // Per-worker telemetry in shared memory, created before the workers start
+    class Telemetry
+    {
+    public:
+        Telemetry(int num_workers, Generators::Index total)
+            : slots_(num_workers > 0 ? num_workers : 1), total_(total), started_ns_(nowNs())
+        {
+        }
+
+        WorkerSlot& slot(int worker_id) const
+        {
+            return slots_[worker_id];
+        }
+
+        int workers() const
+        {
+            return static_cast<int>(slots_.size());
+        }
+
+        Generators::Index total() const
+        {
+            return total_;
+        }
+
+        WorkerStats stats(int worker_id) const
+        {
+            const WorkerSlot& slot = slots_[worker_id];
+            WorkerStats stats{slot.processed.load(std::memory_order_relaxed), slot.readPosition(),
+                              slot.matches.load(std::memory_order_relaxed), 0};
+            uint64_t started = slot.started_ns.load(std::memory_order_relaxed);
+            uint64_t updated = slot.updated_ns.load(std::memory_order_relaxed);
+            if (updated > started)
+                stats.rate = stats.processed / ((updated - started) / 1e9);
+            return stats;
+        }
+
+        uint64_t processed() const
+        {
+            uint64_t sum = 0;
+            for (size_t i = 0; i < slots_.size(); ++i)
+                sum += slots_[i].processed.load(std::memory_order_relaxed);
+            return sum;
+        }
+
+        uint64_t matches() const
+        {
+            uint64_t sum = 0;
+            for (size_t i = 0; i < slots_.size(); ++i)
+                sum += slots_[i].matches.load(std::memory_order_relaxed);
+            return sum;
+        }
+
+        // Aggregate candidates per second since the telemetry was created
+        double rate() const
+        {
+            uint64_t elapsed = nowNs() - started_ns_;
+            return elapsed == 0 ? 0 : processed() / (elapsed / 1e9);
+        }
+
+    private:
+        LoadBalancing::SharedMemory<WorkerSlot> slots_;
+        Generators::Index total_;
+        uint64_t started_ns_;
+    };
+
+    // Parent-side thread that redraws one progress/ETA line on stderr until it is
+    // destroyed. Start it after fork() so the children never inherit it.
+    class ProgressView
+    {
+    public:
+        explicit ProgressView(const Telemetry& telemetry, std::chrono::milliseconds interval = std::chrono::milliseconds(500))
+            : telemetry_(telemetry), thread_([this, interval](std::stop_token token) { loop(token, interval); })
+        {
+        }
+
+        ~ProgressView()
+        {
+            thread_.request_stop();
+            thread_.join();
+            draw();
+            fputc('\n', stderr);
+        }
+
+    private:
+        const Telemetry& telemetry_;
+        std::mutex mutex_;
+        std::condition_variable_any wake_;
+        std::jthread thread_;
+
+        void loop(std::stop_token token, std::chrono::milliseconds interval)
+        {
+            std::unique_lock lock(mutex_);
+            while (!wake_.wait_for(lock, token, interval, []() { return false; }) && !token.stop_requested())
+                draw();
+        }
+
+        void draw() const
+        {
+            Generators::Index total = telemetry_.total();
+            uint64_t processed = telemetry_.processed();
+            double rate = telemetry_.rate();
+            double percent = total == 0 ? 100.0 : std::min(100.0, 100.0 * processed / static_cast<double>(total));
+            double eta = (rate > 0 && processed < total) ? static_cast<double>(total - processed) / rate : 0;
+
+            fprintf(stderr, "\r[%5.1f%%] %llu/%s  %.2f MH/s  ETA %.0f s  found %llu   ", percent,
+                    static_cast<unsigned long long>(processed), Generators::toDecimal(total).c_str(), rate / 1e6, eta,
+                    static_cast<unsigned long long>(telemetry_.matches()));
+            fflush(stderr);
+        }
+    };
+}
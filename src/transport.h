@@ -0,0 +1,281 @@
+#pragma once
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <cstring>
+#include <cerrno>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+namespace Network
+{
+    // Bidirectional stream of text lines
+    class IConnection
+    {
+    public:
+        virtual ~IConnection() = default;
+
+        // Sends one line (without the newline); throws when the peer is gone
+        virtual void send(const std::string& line) = 0;
+
+        // Blocks for the next line; returns false once the peer has closed
+        virtual bool receive(std::string& line) = 0;
+
+        // Reads whatever has arrived without blocking past the first read and
+        // appends the complete lines; returns false once the peer has closed
+        virtual bool receiveAvailable(std::vector<std::string>& lines) = 0;
+
+        // Descriptor that becomes readable when receiveAvailable() has data
+        virtual int handle() const = 0;
+    };
+
+    class IListener
+    {
+    public:
+        virtual ~IListener() = default;
+
+        virtual std::unique_ptr<IConnection> accept() = 0;
+
+        // Descriptor that becomes readable when a peer is waiting
+        virtual int handle() const = 0;
+    };
+
+    // Creates listeners and connections for one kind of address
+    class ITransport
+    {
+    public:
+        virtual ~ITransport() = default;
+
+        virtual std::unique_ptr<IListener> listen(const std::string& address) = 0;
+        virtual std::unique_ptr<IConnection> connect(const std::string& address) = 0;
+    };
+
+    // Line connection over a connected stream socket
+    class SocketConnection : public IConnection
+    {
+    public:
+        explicit SocketConnection(int fd)
+            : fd_(fd)
+        {
+        }
+
+        SocketConnection(const SocketConnection&) = delete;
+        SocketConnection& operator=(const SocketConnection&) = delete;
+
+        ~SocketConnection() override
+        {
+            close(fd_);
+        }
+
+        void send(const std::string& line) override
+        {
+            std::string data = line + "\n";
+            size_t sent = 0;
+            while (sent < data.size())
+            {
+                ssize_t result = ::send(fd_, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+                if (result < 0 && errno == EINTR)
+                    continue;
+                if (result <= 0)
+                    throw std::runtime_error(std::string("Connection lost: ") + strerror(errno));
+                sent += static_cast<size_t>(result);
+            }
+        }
+
+        bool receive(std::string& line) override
+        {
+            while (!takeLine(line))
+            {
+                if (!fill())
+                    return false;
+            }
+            return true;
+        }
+
+        bool receiveAvailable(std::vector<std::string>& lines) override
+        {
+            bool open = fill();
+            std::string line;
+            while (takeLine(line))
+                lines.push_back(std::move(line));
+            return open;
+        }
+
+        int handle() const override
+        {
+            return fd_;
+        }
+
+    private:
+        int fd_;
+        std::string buffer_;
+
+        // One read(); false on end of stream or error
+        bool fill()
+        {
+            char chunk[4096];
+            ssize_t result;
+            do
+            {
+                result = ::recv(fd_, chunk, sizeof(chunk), 0);
+            } while (result < 0 && errno == EINTR);
+
+            if (result <= 0)
+                return false;
+            buffer_.append(chunk, static_cast<size_t>(result));
+            return true;
+        }
+
+        bool takeLine(std::string& line)
+        {
+            size_t end = buffer_.find('\n');
+            if (end == std::string::npos)
+                return false;
+            line = buffer_.substr(0, end);
+            buffer_.erase(0, end + 1);
+            return true;
+        }
+    };
+
+    class SocketListener : public IListener
+    {
+    public:
+        SocketListener(int fd, std::string unlink_path = "")
+            : fd_(fd), unlink_path_(std::move(unlink_path))
+        {
+        }
+
+        SocketListener(const SocketListener&) = delete;
+        SocketListener& operator=(const SocketListener&) = delete;
+
+        ~SocketListener() override
+        {
+            close(fd_);
+            if (!unlink_path_.empty())
+                unlink(unlink_path_.c_str());
+        }
+
+        std::unique_ptr<IConnection> accept() override
+        {
+            int fd;
+            do
+            {
+                fd = ::accept4(fd_, nullptr, nullptr, SOCK_CLOEXEC);
+            } while (fd < 0 && errno == EINTR);
+
+            if (fd < 0)
+                throw std::runtime_error(std::string("Accept failed: ") + strerror(errno));
+            return std::make_unique<SocketConnection>(fd);
+        }
+
+        int handle() const override
+        {
+            return fd_;
+        }
+
+    private:
+        int fd_;
+        std::string unlink_path_;
+    };
+
+    // Stream sockets addressed as "tcp:HOST:PORT" or "unix:PATH"
+    class SocketTransport : public ITransport
+    {
+    public:
+        std::unique_ptr<IListener> listen(const std::string& address) override
+        {
+            if (address.rfind("unix:", 0) == 0)
+            {
+                std::string path = address.substr(5);
+                sockaddr_un local = unixAddress(path);
+                unlink(path.c_str());
+
+                int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+                if (fd < 0 || bind(fd, reinterpret_cast<sockaddr*>(&local), sizeof(local)) != 0 || ::listen(fd, 64) != 0)
+                    fail(fd, "Unable to listen on '" + address + "'");
+                return std::make_unique<SocketListener>(fd, path);
+            }
+
+            addrinfo* info = resolve(address, true);
+            int fd = socket(info->ai_family, info->ai_socktype | SOCK_CLOEXEC, info->ai_protocol);
+            int reuse = 1;
+            if (fd >= 0)
+                setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+            if (fd < 0 || bind(fd, info->ai_addr, info->ai_addrlen) != 0 || ::listen(fd, 64) != 0)
+            {
+                freeaddrinfo(info);
+                fail(fd, "Unable to listen on '" + address + "'");
+            }
+            freeaddrinfo(info);
+            return std::make_unique<SocketListener>(fd);
+        }
+
+        std::unique_ptr<IConnection> connect(const std::string& address) override
+        {
+            if (address.rfind("unix:", 0) == 0)
+            {
+                sockaddr_un remote = unixAddress(address.substr(5));
+                int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+                if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&remote), sizeof(remote)) != 0)
+                    fail(fd, "Unable to connect to '" + address + "'");
+                return std::make_unique<SocketConnection>(fd);
+            }
+
+            addrinfo* info = resolve(address, false);
+            int fd = socket(info->ai_family, info->ai_socktype | SOCK_CLOEXEC, info->ai_protocol);
+            if (fd < 0 || ::connect(fd, info->ai_addr, info->ai_addrlen) != 0)
+            {
+                freeaddrinfo(info);
+                fail(fd, "Unable to connect to '" + address + "'");
+            }
+            freeaddrinfo(info);
+            return std::make_unique<SocketConnection>(fd);
+        }
+
+    private:
+        [[noreturn]] static void fail(int fd, const std::string& message)
+        {
+            int error = errno;
+            if (fd >= 0)
+                close(fd);
+            throw std::runtime_error(message + ": " + strerror(error));
+        }
+
+        static sockaddr_un unixAddress(const std::string& path)
+        {
+            sockaddr_un address{};
+            if (path.empty() || path.size() >= sizeof(address.sun_path))
+                throw std::invalid_argument("Invalid unix socket path '" + path + "'.");
+            address.sun_family = AF_UNIX;
+            std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+            return address;
+        }
+
+        static addrinfo* resolve(const std::string& address, bool passive)
+        {
+            if (address.rfind("tcp:", 0) != 0)
+                throw std::invalid_argument("Unknown address '" + address + "', expected tcp:HOST:PORT or unix:PATH.");
+
+            size_t colon = address.rfind(':');
+            if (colon <= 4)
+                throw std::invalid_argument("Address '" + address + "' is missing the port.");
+            std::string host = address.substr(4, colon - 4);
+            std::string port = address.substr(colon + 1);
+
+            addrinfo hints{};
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+            hints.ai_flags = passive ? AI_PASSIVE : 0;
+
+            addrinfo* info = nullptr;
+            int result = getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &info);
+            if (result != 0)
+                throw std::runtime_error("Unable to resolve '" + address + "': " + gai_strerror(result));
+            return info;
+        }
+    };
+}
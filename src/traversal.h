@@ -0,0 +1,252 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <stdexcept>
+#include <algorithm>
+
+#include "index.h"
+
+namespace Generators
+{
+    // Order in which a sweep visits the candidates of a keyspace
+    enum class Order
+    {
+        Linear,  // lexicographic, as the generator produces them
+        Strided, // blocks spread out by a fixed step coprime to their count
+        Random   // blocks shuffled by a keyed Feistel network
+    };
+
+    inline const char* orderName(Order order)
+    {
+        switch (order)
+        {
+        case Order::Strided:
+            return "strided";
+        case Order::Random:
+            return "random";
+        default:
+            return "linear";
+        }
+    }
+
+    inline Order parseOrder(const std::string& name)
+    {
+        for (Order order : {Order::Linear, Order::Strided, Order::Random})
+        {
+            if (name == orderName(order))
+                return order;
+        }
+        throw std::invalid_argument("Unknown order '" + name + "', expected linear, strided or random.");
+    }
+
+    // Bijection from the positions the scheduler hands out to candidate indices,
+    // both in [0, total). Positions are grouped into blocks of blockSize(total),
+    // and whole blocks are permuted while candidates inside a block stay consecutive,
+    // so the generator still produces runs and only seeks once per block. The
+    // partial block at the end of the keyspace moves as a whole into a slot
+    // between the others, so it is not always visited last. Ranges, checkpoints
+    // and shards stay in positions; matches and output records carry the real
+    // candidate index.
+    //
+    // Visiting blocks out of order makes the time to hit a key independent of
+    // where it sorts, e.g. "zzzzz" is no longer the worst case, and likely keys
+    // that sit close together are spread over all workers.
+    class Traversal
+    {
+    public:
+        // Blocks are about a thousandth of the keyspace, clamped to these bounds;
+        // MinBlockSize is a multiple of every hasher's lane count
+        static constexpr Index MaxBlockSize = Index{1} << 16;
+        static constexpr Index MinBlockSize = 64;
+        static constexpr Index TargetBlocks = 1024;
+        static constexpr int Rounds = 4;
+
+        Traversal()
+            : Traversal(Order::Linear, 0, 0)
+        {
+        }
+
+        Traversal(Order order, Index total, uint64_t seed)
+            : order_(order), seed_(seed), block_size_(blockSize(total)), blocks_(total / block_size_), tail_(total % block_size_)
+        {
+            if (order_ == Order::Strided && blocks_ > 1)
+            {
+                // Roughly the golden ratio of the block count, so consecutive
+                // positions land far apart and never line up with a short period
+                step_ = blocks_ / 2 + blocks_ / 8 - blocks_ / 128;
+                while (gcd(step_, blocks_) != 1)
+                    ++step_;
+                tail_slot_ = step_ % (blocks_ + 1);
+            }
+            else if (order_ == Order::Random && blocks_ > 1)
+            {
+                int bits = 0;
+                while (bits < 128 && (Index{1} << bits) < blocks_)
+                    ++bits;
+                half_bits_ = (bits + 1) / 2;
+                half_mask_ = half_bits_ >= 64 ? ~uint64_t{0} : (uint64_t{1} << half_bits_) - 1;
+
+                uint64_t state = seed_;
+                for (uint64_t& key : keys_)
+                    key = mix(state += 0x9E3779B97F4A7C15ull);
+            }
+            if (order_ == Order::Random)
+                tail_slot_ = mix(seed_) % (blocks_ + 1);
+        }
+
+        Order order() const
+        {
+            return order_;
+        }
+
+        uint64_t seed() const
+        {
+            return seed_;
+        }
+
+        // Candidates per permuted block of a keyspace of total candidates, so even
+        // small keyspaces are split into enough blocks to be shuffled
+        static Index blockSize(Index total)
+        {
+            Index size = std::clamp(total / TargetBlocks, MinBlockSize, MaxBlockSize);
+            return size - size % MinBlockSize;
+        }
+
+        // Candidate index visited at position
+        Index indexOf(Index position) const
+        {
+            Index index, left;
+            locate(position, index, left);
+            return index;
+        }
+
+        // Splits the positions [begin, end) into runs of consecutive candidates and
+        // calls f(index, count, position) for every run in order
+        template <typename F>
+        void forEachRun(Index begin, Index end, F&& f) const
+        {
+            if (order_ == Order::Linear)
+            {
+                if (begin < end)
+                    f(begin, end - begin, begin);
+                return;
+            }
+
+            while (begin < end)
+            {
+                Index index, left;
+                locate(begin, index, left);
+                Index count = std::min(end - begin, left);
+                f(index, count, begin);
+                begin += count;
+            }
+        }
+
+    private:
+        Order order_;
+        uint64_t seed_;
+        Index block_size_;
+        // Number of whole blocks, the domain of the permutation
+        Index blocks_;
+        // Size of the partial block and the block slot it is visited in
+        Index tail_;
+        Index tail_slot_ = 0;
+        Index step_ = 1;
+        int half_bits_ = 0;
+        uint64_t half_mask_ = 0;
+        uint64_t keys_[Rounds] = {};
+
+        // Candidate index at position and how many consecutive ones follow from there
+        void locate(Index position, Index& index, Index& left) const
+        {
+            if (order_ == Order::Linear)
+            {
+                index = position;
+                left = MaxIndex - position;
+                return;
+            }
+
+            Index tail_begin = tail_slot_ * block_size_;
+            if (tail_ != 0 && position >= tail_begin)
+            {
+                if (position - tail_begin < tail_)
+                {
+                    index = blocks_ * block_size_ + (position - tail_begin);
+                    left = tail_ - (position - tail_begin);
+                    return;
+                }
+                // Whole blocks after the tail's slot
+                position -= tail_;
+            }
+
+            Index offset = position % block_size_;
+            index = blockAt(position / block_size_) * block_size_ + offset;
+            left = block_size_ - offset;
+        }
+
+        Index blockAt(Index block) const
+        {
+            if (blocks_ <= 1)
+                return block;
+            if (order_ == Order::Strided)
+                return mulMod(block, step_, blocks_);
+
+            // The network permutes the next power of four above the block count;
+            // walking the cycle until it lands inside keeps it a bijection there
+            do
+                block = feistel(block);
+            while (block >= blocks_);
+            return block;
+        }
+
+        Index feistel(Index value) const
+        {
+            uint64_t left = static_cast<uint64_t>(value >> half_bits_) & half_mask_;
+            uint64_t right = static_cast<uint64_t>(value) & half_mask_;
+            for (uint64_t key : keys_)
+            {
+                uint64_t next = left ^ (mix(right ^ key) & half_mask_);
+                left = right;
+                right = next;
+            }
+            return (Index{left} << half_bits_) | right;
+        }
+
+        // splitmix64 finaliser
+        static uint64_t mix(uint64_t x)
+        {
+            x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+            x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+            return x ^ (x >> 31);
+        }
+
+        static Index gcd(Index a, Index b)
+        {
+            while (b != 0)
+            {
+                Index r = a % b;
+                a = b;
+                b = r;
+            }
+            return a;
+        }
+
+        // a * b % m without overflowing 128 bits; a and b are below m
+        static Index mulMod(Index a, Index b, Index m)
+        {
+            if (m <= (Index{1} << 64))
+                return a * b % m;
+
+            Index result = 0;
+            while (b != 0)
+            {
+                if (b & 1)
+                    result = (result >= m - a) ? result - (m - a) : result + a;
+                a = (a >= m - a) ? a - (m - a) : a + a;
+                b >>= 1;
+            }
+            return result;
+        }
+    };
+}
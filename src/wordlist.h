@@ -0,0 +1,103 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#include "mapped_file.h"
+
+namespace Dictionary
+{
+    // Wordlist with one word per line, memory-mapped once in the parent so
+    // every worker reads the same page cache copy with no per-process load.
+    //
+    // Workers are handed byte ranges rather than word numbers: a range owns the
+    // words that start inside it, so any split of [0, size()) is aligned to line
+    // boundaries without the parent scanning the file first. Carriage returns
+    // before the newline are stripped and empty lines are skipped.
+    class Wordlist
+    {
+    public:
+        static constexpr size_t SampleSize = size_t{1} << 20;
+
+        explicit Wordlist(const std::string& path)
+            : file_(path)
+        {
+        }
+
+        // Bytes in the file
+        size_t size() const
+        {
+            return file_.size();
+        }
+
+        // Calls f(word, offset) for every word starting in [begin, end) until f returns false
+        template <typename F>
+        void forEachWord(size_t begin, size_t end, F&& f) const
+        {
+            const char* data = file_.data();
+            size_t size = file_.size();
+            end = std::min(end, size);
+
+            size_t offset = alignUp(begin);
+            while (offset < end)
+            {
+                const char* newline = static_cast<const char*>(std::memchr(data + offset, '\n', size - offset));
+                size_t line_end = newline == nullptr ? size : static_cast<size_t>(newline - data);
+
+                size_t length = line_end - offset;
+                if (length != 0 && data[offset + length - 1] == '\r')
+                    --length;
+                if (length != 0 && !f(std::string_view(data + offset, length), offset))
+                    return;
+                offset = line_end + 1;
+            }
+        }
+
+        // Words starting in [begin, end)
+        size_t countWords(size_t begin, size_t end) const
+        {
+            size_t count = 0;
+            forEachWord(begin, end, [&count](std::string_view, size_t)
+                        { ++count; return true; });
+            return count;
+        }
+
+        // Words starting in [begin, end), extrapolated from the first SampleSize
+        // bytes, so sizing up a large list never reads all of it
+        size_t estimateWords(size_t begin, size_t end) const
+        {
+            end = std::min(end, file_.size());
+            if (end <= begin || end - begin <= SampleSize)
+                return countWords(begin, end);
+
+            size_t sampled = countWords(begin, begin + SampleSize);
+            return static_cast<size_t>(static_cast<double>(sampled) * (end - begin) / SampleSize);
+        }
+
+        // Word starting at offset
+        std::string_view wordAt(size_t offset) const
+        {
+            std::string_view word;
+            forEachWord(offset, offset + 1, [&word](std::string_view found, size_t)
+                        { word = found; return false; });
+            return word;
+        }
+
+        // First line start at or after offset
+        size_t alignUp(size_t offset) const
+        {
+            if (offset == 0 || offset >= file_.size())
+                return std::min(offset, file_.size());
+            if (file_.data()[offset - 1] == '\n')
+                return offset;
+
+            const char* newline = static_cast<const char*>(std::memchr(file_.data() + offset, '\n', file_.size() - offset));
+            return newline == nullptr ? file_.size() : static_cast<size_t>(newline - file_.data()) + 1;
+        }
+
+    private:
+        Storage::MappedFile file_;
+    };
+}
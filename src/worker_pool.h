@@ -0,0 +1,263 @@
+#pragma once
+
+#include <unistd.h>
+#include <sys/wait.h>
+#include <semaphore.h>
+#include <time.h>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <functional>
+#include <type_traits>
+#include <stdexcept>
+#include <string>
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+
+#include "scheduler.h"
+#include "shared_memory.h"
+
+namespace LoadBalancing
+{
+    // Persistent pool of forked workers that runs many jobs without re-forking.
+    //
+    // The workers are forked once in the constructor and then sleep on their own
+    // process-shared semaphore. run() copies the job into shared memory, wakes
+    // every worker and waits until each has drained the job's index space, which
+    // the workers split among themselves with the same guided chunking as
+    // DynamicScheduler. Because the workers already exist, everything they use
+    // per job has to travel through that shared memory, hence the trivially
+    // copyable Job.
+    template <typename Job>
+    class WorkerPool
+    {
+        static_assert(std::is_trivially_copyable_v<Job>, "Jobs are copied through shared memory.");
+
+    public:
+        // task(worker_id, job, chunk) is called for every chunk a worker claims
+        using Task = std::function<void(int, const Job&, Range)>;
+
+        WorkerPool(int num_workers, Task task, size_t min_chunk = 1 << 12, size_t max_chunk = 1 << 22)
+            : num_workers_(num_workers), task_(std::move(task)), min_chunk_(min_chunk), max_chunk_(max_chunk),
+              control_(), slots_(num_workers > 0 ? num_workers : 1)
+        {
+            if (num_workers_ < 1)
+                throw std::invalid_argument("Number of workers must be at least 1.");
+            if (!task_)
+                throw std::invalid_argument("Task function must be valid.");
+
+            auto start_time = std::chrono::steady_clock::now();
+
+            if (sem_init(&control_->done, 1, 0) != 0)
+                throw std::runtime_error(std::string("Semaphore initialisation failed: ") + strerror(errno));
+            for (int i = 0; i < num_workers_; ++i)
+            {
+                if (sem_init(&slots_[i].start, 1, 0) != 0)
+                    throw std::runtime_error(std::string("Semaphore initialisation failed: ") + strerror(errno));
+            }
+
+            for (int i = 0; i < num_workers_; ++i)
+            {
+                pid_t pid = fork();
+                if (pid < 0)
+                {
+                    shutdown();
+                    throw std::runtime_error(std::string("Fork failed: ") + strerror(errno));
+                }
+                if (pid == 0)
+                {
+                    workerLoop(i);
+                    _exit(0);
+                }
+                worker_pids_.push_back(pid);
+            }
+
+            // Every worker reports in once before blocking on its start semaphore
+            waitDone();
+            spawn_ms_ = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time).count();
+        }
+
+        WorkerPool(const WorkerPool&) = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
+
+        ~WorkerPool()
+        {
+            shutdown();
+        }
+
+        // Runs job over the indices [0, total) on all workers and blocks until
+        // it is done. Returns the wall time of the job in milliseconds. Throws if
+        // a worker died meanwhile, after which the pool is shut down.
+        double run(const Job& job, size_t total)
+        {
+            if (worker_pids_.empty())
+                throw std::logic_error("Worker pool has been shut down.");
+
+            auto start_time = std::chrono::steady_clock::now();
+
+            control_->job = job;
+            control_->total = total;
+            control_->cursor.store(0, std::memory_order_relaxed);
+
+            for (int i = 0; i < num_workers_; ++i)
+                sem_post(&slots_[i].start);
+            waitDone();
+
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_time).count();
+        }
+
+        // Time it took to fork the workers and have all of them ready
+        double spawnMs() const
+        {
+            return spawn_ms_;
+        }
+
+        int size() const
+        {
+            return num_workers_;
+        }
+
+        // Stops and reaps all workers
+        void shutdown()
+        {
+            if (worker_pids_.empty())
+                return;
+
+            control_->shutdown = true;
+            for (int i = 0; i < num_workers_; ++i)
+                sem_post(&slots_[i].start);
+
+            for (pid_t pid : worker_pids_)
+            {
+                int status;
+                if (waitpid(pid, &status, 0) == -1)
+                    std::cerr << "Error waiting for worker process " << pid << ": " << strerror(errno) << std::endl;
+            }
+            worker_pids_.clear();
+        }
+
+    private:
+        struct Control
+        {
+            sem_t done;
+            std::atomic<size_t> cursor{0};
+            size_t total = 0;
+            bool shutdown = false;
+            Job job;
+        };
+
+        // One cache line per worker so wake-ups do not contend
+        struct alignas(64) Slot
+        {
+            sem_t start;
+        };
+
+        int num_workers_;
+        Task task_;
+        size_t min_chunk_;
+        size_t max_chunk_;
+        SharedMemory<Control> control_;
+        SharedMemory<Slot> slots_;
+        std::vector<pid_t> worker_pids_;
+        double spawn_ms_ = 0;
+
+        void workerLoop(int worker_id)
+        {
+            sem_post(&control_->done);
+
+            while (true)
+            {
+                while (sem_wait(&slots_[worker_id].start) != 0 && errno == EINTR)
+                {
+                }
+                if (control_->shutdown)
+                    return;
+
+                try
+                {
+                    Range chunk;
+                    while (claim(chunk))
+                        task_(worker_id, control_->job, chunk);
+                }
+                catch (const std::exception& ex)
+                {
+                    std::cerr << "Exception in worker process: " << ex.what() << std::endl;
+                }
+                catch (...)
+                {
+                    std::cerr << "Unknown exception in worker process." << std::endl;
+                }
+
+                sem_post(&control_->done);
+            }
+        }
+
+        bool claim(Range& chunk)
+        {
+            size_t total = control_->total;
+            size_t cursor = control_->cursor.load(std::memory_order_relaxed);
+            while (cursor < total)
+            {
+                size_t size = std::min(DynamicScheduler::chunkSize(total - cursor, num_workers_, min_chunk_, max_chunk_),
+                                       total - cursor);
+                if (control_->cursor.compare_exchange_weak(cursor, cursor + size, std::memory_order_relaxed))
+                {
+                    chunk = {cursor, cursor + size};
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // How long waitDone() blocks before checking that no worker has died
+        static constexpr long LivenessCheckNs = 100'000'000;
+
+        // Waits until every worker has posted done. A worker that died (signal,
+        // OOM kill) never posts, so the wait times out regularly to look for one;
+        // if there is one the pool is shut down and the job reported as failed.
+        void waitDone()
+        {
+            int pending = num_workers_;
+            while (pending > 0)
+            {
+                timespec deadline;
+                clock_gettime(CLOCK_REALTIME, &deadline);
+                deadline.tv_nsec += LivenessCheckNs;
+                if (deadline.tv_nsec >= 1'000'000'000)
+                {
+                    deadline.tv_sec += 1;
+                    deadline.tv_nsec -= 1'000'000'000;
+                }
+
+                if (sem_timedwait(&control_->done, &deadline) == 0)
+                    --pending;
+                else if (errno == ETIMEDOUT)
+                    checkWorkers();
+                else if (errno != EINTR)
+                    throw std::runtime_error(std::string("Waiting for workers failed: ") + strerror(errno));
+            }
+        }
+
+        // Throws if a worker process has exited; the rest are stopped and reaped
+        void checkWorkers()
+        {
+            for (size_t i = 0; i < worker_pids_.size(); ++i)
+            {
+                int status;
+                pid_t pid = worker_pids_[i];
+                if (waitpid(pid, &status, WNOHANG) != pid)
+                    continue;
+
+                worker_pids_.erase(worker_pids_.begin() + i);
+                // Survivors stop claiming chunks and exit once their current one is done
+                control_->cursor.store(control_->total, std::memory_order_relaxed);
+                shutdown();
+
+                if (WIFSIGNALED(status))
+                    throw std::runtime_error("Worker process " + std::to_string(pid) + " terminated by signal " + std::to_string(WTERMSIG(status)) + ".");
+                throw std::runtime_error("Worker process " + std::to_string(pid) + " exited unexpectedly with status " + std::to_string(WEXITSTATUS(status)) + ".");
+            }
+        }
+    };
+}